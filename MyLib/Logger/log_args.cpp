@@ -0,0 +1,354 @@
+#include <stdarg.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log_args.h"
+#include "../Assert/my_assert.h"
+
+static const size_t max_spec_length = 64;
+static const char   missing_arg []  = "<?>";
+
+static enum LogArgType spec_type    (const char length [2], const char conversion);
+static size_t          arg_size     (const enum LogArgType type);
+static int             append_text  (char* const buffer, const size_t size, const int written,
+                                     const char* const text, const size_t length);
+
+static enum LogArgType spec_type (const char length [2], const char conversion)
+{
+    switch (conversion)
+    {
+        case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+        {
+            switch (length [0])
+            {
+                case 'l': return (length [1] == 'l') ? kArgLongLong : kArgLong;
+                case 'q': return kArgLongLong;
+                case 'j': return kArgIntmax;
+                case 'z': return kArgSize;
+                case 't': return kArgPtrdiff;
+                default:  return kArgInt;
+            }
+        }
+        case 'c':
+        {
+            return (length [0] == 'l') ? kArgInvalid : kArgInt;
+        }
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        {
+            return (length [0] == 'L') ? kArgLongDouble : kArgDouble;
+        }
+        case 's':
+        {
+            return (length [0] == 'l') ? kArgInvalid : kArgString;
+        }
+        case 'p':
+        {
+            return kArgPointer;
+        }
+        case 'n':
+        {
+            return kArgSkip;
+        }
+        case '%': case 'm':
+        {
+            return kArgNone;
+        }
+        default:
+        {
+            return kArgInvalid;
+        }
+    }
+}
+
+static size_t arg_size (const enum LogArgType type)
+{
+    switch (type)
+    {
+        case kArgInt:        return sizeof (int);
+        case kArgLong:       return sizeof (long);
+        case kArgLongLong:   return sizeof (long long);
+        case kArgIntmax:     return sizeof (intmax_t);
+        case kArgSize:       return sizeof (size_t);
+        case kArgPtrdiff:    return sizeof (ptrdiff_t);
+        case kArgDouble:     return sizeof (double);
+        case kArgLongDouble: return sizeof (long double);
+        case kArgPointer:    return sizeof (void*);
+        default:             return 0;
+    }
+}
+
+const char* next_log_spec (const char* format, struct log_spec* const spec)
+{
+    ASSERT(format != NULL, "Invalid argument for next_log_spec %p\n", format);
+    ASSERT(spec   != NULL, "Invalid argument for next_log_spec %p\n", spec);
+
+    format = strchr (format, '%');
+    if (format == NULL)
+    {
+        return NULL;
+    }
+
+    spec->begin          = format++;
+    spec->star_width     = 0;
+    spec->star_precision = 0;
+
+    while (*format != '\0' && strchr ("-+ #0'I", *format) != NULL)
+    {
+        format++;
+    }
+
+    if (*format == '*')
+    {
+        spec->star_width = 1;
+        format++;
+    }
+    while (*format >= '0' && *format <= '9')
+    {
+        format++;
+    }
+
+    if (*format == '.')
+    {
+        format++;
+        if (*format == '*')
+        {
+            spec->star_precision = 1;
+            format++;
+        }
+        while (*format >= '0' && *format <= '9')
+        {
+            format++;
+        }
+    }
+
+    char length [2] = {};
+    while (*format != '\0' && strchr ("hlLqjzt", *format) != NULL)
+    {
+        length [(length [0] == '\0') ? 0 : 1] = *format;
+        format++;
+    }
+
+    spec->type = (*format == '\0') ? kArgInvalid : spec_type (length, *format);
+    spec->end  = (*format == '\0') ? format : format + 1;
+
+    return spec->end;
+}
+
+size_t pack_log_args (unsigned char* const buffer, const size_t capacity,
+                      const char* const format, va_list args)
+{
+    ASSERT(buffer != NULL, "Invalid argument for pack_log_args %p\n", buffer);
+    ASSERT(format != NULL, "Invalid argument for pack_log_args %p\n", format);
+
+    size_t used = 0;
+    struct log_spec spec = {};
+    const char* position = format;
+
+    while ((position = next_log_spec (position, &spec)) != NULL && spec.type != kArgInvalid)
+    {
+        int stars [2] = {};
+        int star_count = 0;
+        if (spec.star_width)
+        {
+            stars [star_count++] = va_arg (args, int);
+        }
+        if (spec.star_precision)
+        {
+            stars [star_count++] = va_arg (args, int);
+        }
+
+        unsigned char value [sizeof (long double)] = {};
+        const char* string = NULL;
+
+        switch (spec.type)
+        {
+            case kArgInt:        {int         x = va_arg (args, int);         memcpy (value, &x, sizeof (x)); break;}
+            case kArgLong:       {long        x = va_arg (args, long);        memcpy (value, &x, sizeof (x)); break;}
+            case kArgLongLong:   {long long   x = va_arg (args, long long);   memcpy (value, &x, sizeof (x)); break;}
+            case kArgIntmax:     {intmax_t    x = va_arg (args, intmax_t);    memcpy (value, &x, sizeof (x)); break;}
+            case kArgSize:       {size_t      x = va_arg (args, size_t);      memcpy (value, &x, sizeof (x)); break;}
+            case kArgPtrdiff:    {ptrdiff_t   x = va_arg (args, ptrdiff_t);   memcpy (value, &x, sizeof (x)); break;}
+            case kArgDouble:     {double      x = va_arg (args, double);      memcpy (value, &x, sizeof (x)); break;}
+            case kArgLongDouble: {long double x = va_arg (args, long double); memcpy (value, &x, sizeof (x)); break;}
+            case kArgPointer:    {void*       x = va_arg (args, void*);       memcpy (value, &x, sizeof (x)); break;}
+            case kArgString:     {string = va_arg (args, const char*); break;}
+            case kArgSkip:       {(void) va_arg (args, void*); break;}
+            default:             {break;}
+        }
+
+        size_t size = star_count * sizeof (int) + arg_size (spec.type) + ((spec.type == kArgString) ? sizeof (uint16_t) : 0);
+        if (capacity - used < size)
+        {
+            break;
+        }
+
+        memcpy (buffer + used, stars, star_count * sizeof (int));
+        used += star_count * sizeof (int);
+        memcpy (buffer + used, value, arg_size (spec.type));
+        used += arg_size (spec.type);
+
+        if (spec.type == kArgString)
+        {
+            if (string == NULL)
+            {
+                string = "(null)";
+            }
+            size_t length = strnlen (string, UINT16_MAX);
+            if (length > capacity - used - sizeof (uint16_t))
+            {
+                length = capacity - used - sizeof (uint16_t);
+            }
+
+            uint16_t stored_length = (uint16_t) length;
+            memcpy (buffer + used, &stored_length, sizeof (stored_length));
+            memcpy (buffer + used + sizeof (stored_length), string, length);
+            used += sizeof (stored_length) + length;
+        }
+    }
+
+    return used;
+}
+
+static int append_text (char* const buffer, const size_t size, const int written,
+                        const char* const text, const size_t length)
+{
+    if ((size_t) written < size)
+    {
+        size_t room = size - written - 1;
+        memcpy (buffer + written, text, (length < room) ? length : room);
+    }
+    return written + (int) length;
+}
+
+int format_log_args (char* const buffer, const size_t size, const char* const format,
+                     const unsigned char* const args, const size_t args_size)
+{
+    ASSERT(buffer != NULL && size > 0, "Invalid argument for format_log_args %p\n", buffer);
+    ASSERT(format != NULL,             "Invalid argument for format_log_args %p\n", format);
+
+    int written = 0;
+    size_t used = 0;
+    struct log_spec spec = {};
+    const char* position = format;
+    const char* next = NULL;
+    int exhausted = 0;
+
+    while ((next = next_log_spec (position, &spec)) != NULL)
+    {
+        written = append_text (buffer, size, written, position, spec.begin - position);
+        position = next;
+
+        if (spec.type == kArgInvalid)
+        {
+            position = spec.begin;
+            break;
+        }
+
+        int star_count = spec.star_width + spec.star_precision;
+        size_t size_needed = star_count * sizeof (int) + arg_size (spec.type)
+                             + ((spec.type == kArgString) ? sizeof (uint16_t) : 0);
+        if (spec.type != kArgNone && (exhausted || args_size - used < size_needed))
+        {
+            exhausted = 1;
+            written = append_text (buffer, size, written, missing_arg, sizeof (missing_arg) - 1);
+            continue;
+        }
+
+        int stars [2] = {};
+        memcpy (stars, args + used, star_count * sizeof (int));
+        used += star_count * sizeof (int);
+
+        // '*' are replaced with the stored numbers, a negative precision means none
+        char spec_text [max_spec_length] = "";
+        size_t spec_length = 0;
+        int star = 0;
+        for (const char* c = spec.begin; c < spec.end && spec_length + 16 < max_spec_length; c++)
+        {
+            if (*c == '*')
+            {
+                int value = stars [star++];
+                if (c [-1] == '.' && value < 0)
+                {
+                    spec_length--;
+                    continue;
+                }
+                spec_length += snprintf (spec_text + spec_length, max_spec_length - spec_length, "%d", value);
+            }
+            else
+            {
+                spec_text [spec_length++] = *c;
+            }
+        }
+        spec_text [spec_length] = '\0';
+
+        char* out = buffer + (((size_t) written < size) ? written : size - 1);
+        size_t room = ((size_t) written < size) ? size - written : 1;
+        const unsigned char* value = args + used;
+        int length = 0;
+
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wformat-nonliteral"
+        switch (spec.type)
+        {
+            case kArgInt:        {int         x = 0; memcpy (&x, value, sizeof (x)); length = snprintf (out, room, spec_text, x); break;}
+            case kArgLong:       {long        x = 0; memcpy (&x, value, sizeof (x)); length = snprintf (out, room, spec_text, x); break;}
+            case kArgLongLong:   {long long   x = 0; memcpy (&x, value, sizeof (x)); length = snprintf (out, room, spec_text, x); break;}
+            case kArgIntmax:     {intmax_t    x = 0; memcpy (&x, value, sizeof (x)); length = snprintf (out, room, spec_text, x); break;}
+            case kArgSize:       {size_t      x = 0; memcpy (&x, value, sizeof (x)); length = snprintf (out, room, spec_text, x); break;}
+            case kArgPtrdiff:    {ptrdiff_t   x = 0; memcpy (&x, value, sizeof (x)); length = snprintf (out, room, spec_text, x); break;}
+            case kArgDouble:     {double      x = 0; memcpy (&x, value, sizeof (x)); length = snprintf (out, room, spec_text, x); break;}
+            case kArgLongDouble: {long double x = 0; memcpy (&x, value, sizeof (x)); length = snprintf (out, room, spec_text, x); break;}
+            case kArgPointer:    {void*       x = 0; memcpy (&x, value, sizeof (x)); length = snprintf (out, room, spec_text, x); break;}
+            case kArgString:
+            {
+                uint16_t string_length = 0;
+                memcpy (&string_length, value, sizeof (string_length));
+                if (args_size - used - sizeof (string_length) < string_length)
+                {
+                    string_length = 0;
+                }
+                used += sizeof (string_length) + string_length;
+
+                // Precision keeps the copy from needing a terminator
+                spec_text [spec_length - 1] = '\0';
+                char* dot = strchr (spec_text, '.');
+                if (dot == NULL || string_length < atoi (dot + 1))
+                {
+                    if (dot != NULL)
+                    {
+                        *dot = '\0';
+                    }
+                    snprintf (spec_text + strlen (spec_text), max_spec_length - strlen (spec_text),
+                              ".%us", (unsigned) string_length);
+                }
+                else
+                {
+                    strcat (spec_text, "s");
+                }
+                length = snprintf (out, room, spec_text, (const char*) (value + sizeof (string_length)));
+                break;
+            }
+            case kArgNone:
+            {
+                length = snprintf (out, room, spec_text);
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+        #pragma GCC diagnostic pop
+
+        used += arg_size (spec.type);
+        written += (length > 0) ? length : 0;
+    }
+
+    written = append_text (buffer, size, written, position, strlen (position));
+    buffer [((size_t) written < size) ? written : size - 1] = '\0';
+
+    return written;
+}
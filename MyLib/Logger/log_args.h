@@ -0,0 +1,52 @@
+#ifndef LOG_ARGS_H
+#define LOG_ARGS_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+// printf arguments are copied as raw bytes in the order the format string reads them,
+// so the text can be made later on another thread or by an offline decoder.
+// Strings are stored inline (uint16 length + bytes) and cut to fit; %n is skipped,
+// %ls and %lc aren't supported. An unknown conversion stops packing.
+
+enum LogArgType
+{
+    kArgNone       = 0,
+    kArgInt        = 1,
+    kArgLong       = 2,
+    kArgLongLong   = 3,
+    kArgIntmax     = 4,
+    kArgSize       = 5,
+    kArgPtrdiff    = 6,
+    kArgDouble     = 7,
+    kArgLongDouble = 8,
+    kArgString     = 9,
+    kArgPointer    = 10,
+    kArgSkip       = 11,
+    kArgInvalid    = 12,
+};
+
+struct log_spec
+{
+    const char* begin;
+    const char* end;
+
+    enum LogArgType type;
+
+    int star_width;
+    int star_precision;
+};
+
+// Finds the next conversion starting at format, NULL when there are none left
+const char* next_log_spec (const char* format, struct log_spec* const spec);
+
+// Returns the number of bytes used
+size_t pack_log_args (unsigned char* const buffer, const size_t capacity,
+                      const char* const format, va_list args);
+
+// snprintf-like: returns the length the text would have, writes at most size - 1 chars.
+// Arguments missing from a cut record are printed as "<?>".
+int format_log_args (char* const buffer, const size_t size, const char* const format,
+                     const unsigned char* const args, const size_t args_size);
+
+#endif // LOG_ARGS_H
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <new>
+
+#include "logging.h"
+#include "log_args.h"
+
+// Usage: log_decoder [binary log] [text output]
+// Prints the records in the text format of Log, stdin and stdout by default.
+
+static const size_t read_chunk  = 64 * 1024;
+static const size_t header_max  = 512;
+static const size_t message_max = 4096;
+// Ids are dense in the writing process, a bigger one means a damaged log
+static const size_t max_site_id = 1 << 24;
+
+struct reader
+{
+    const unsigned char* data;
+
+    size_t size;
+
+    size_t position;
+
+    int failed;
+};
+
+static const unsigned char* take        (struct reader* const input, const size_t size);
+static uint64_t             take_number (struct reader* const input, const size_t size);
+static char*                take_string (struct reader* const input);
+static unsigned char*       read_all    (FILE* const file, size_t* const size);
+static int                  take_site   (struct reader* const input, struct log_site** const sites,
+                                         size_t* const site_capacity);
+static int                  decode      (struct reader* const input, FILE* const output);
+
+static const unsigned char* take (struct reader* const input, const size_t size)
+{
+    if (input->size - input->position < size)
+    {
+        input->failed = 1;
+        return NULL;
+    }
+
+    const unsigned char* bytes = input->data + input->position;
+    input->position += size;
+    return bytes;
+}
+
+static uint64_t take_number (struct reader* const input, const size_t size)
+{
+    const unsigned char* bytes = take (input, size);
+    uint64_t value = 0;
+    for (size_t i = 0; bytes != NULL && i < size; i++)
+    {
+        value |= (uint64_t) bytes [i] << (8 * i);
+    }
+    return value;
+}
+
+// Site strings live until the program ends
+static char* take_string (struct reader* const input)
+{
+    size_t length = take_number (input, sizeof (uint16_t));
+    const unsigned char* bytes = take (input, length);
+    if (bytes == NULL)
+    {
+        return NULL;
+    }
+
+    char* string = (char*) calloc (length + 1, sizeof (char));
+    if (string != NULL)
+    {
+        memcpy (string, bytes, length);
+    }
+    return string;
+}
+
+static unsigned char* read_all (FILE* const file, size_t* const size)
+{
+    unsigned char* data = NULL;
+    *size = 0;
+
+    while (1)
+    {
+        unsigned char* grown = (unsigned char*) realloc (data, *size + read_chunk);
+        if (grown == NULL)
+        {
+            free (data);
+            return NULL;
+        }
+        data = grown;
+
+        size_t count = fread (data + *size, sizeof (unsigned char), read_chunk, file);
+        *size += count;
+        if (count < read_chunk)
+        {
+            break;
+        }
+    }
+
+    if (ferror (file))
+    {
+        free (data);
+        return NULL;
+    }
+    return data;
+}
+
+// Sites are indexed by id, a redefinition replaces the site
+static int take_site (struct reader* const input, struct log_site** const sites, size_t* const site_capacity)
+{
+    size_t id = take_number (input, sizeof (uint32_t));
+    int line  = (int) take_number (input, sizeof (uint32_t));
+    const char* file   = take_string (input);
+    const char* func   = take_string (input);
+    const char* format = take_string (input);
+    if (input->failed || file == NULL || func == NULL || format == NULL || id == 0 || id > max_site_id)
+    {
+        input->failed = 1;
+        return -1;
+    }
+
+    if (id >= *site_capacity)
+    {
+        size_t capacity = (id + 1 > 2 * *site_capacity) ? id + 1 : 2 * *site_capacity;
+        struct log_site* grown = (struct log_site*) realloc (*sites, capacity * sizeof (struct log_site));
+        if (grown == NULL)
+        {
+            fprintf (stderr, "Can't allocate %zu log sites\n", capacity);
+            return -1;
+        }
+        memset ((void*) (grown + *site_capacity), 0, (capacity - *site_capacity) * sizeof (struct log_site));
+        *sites = grown;
+        *site_capacity = capacity;
+    }
+
+    new (&(*sites) [id]) log_site {file, func, line, format, (uint32_t) id, 0};
+    return 0;
+}
+
+static int decode (struct reader* const input, FILE* const output)
+{
+    const unsigned char* magic = take (input, sizeof (binary_log_magic));
+    if (magic == NULL || memcmp (magic, binary_log_magic, sizeof (binary_log_magic)) != 0)
+    {
+        fprintf (stderr, "Not a binary log\n");
+        return -1;
+    }
+    if (take_number (input, sizeof (uint16_t)) != binary_log_version)
+    {
+        fprintf (stderr, "Unsupported binary log version\n");
+        return -1;
+    }
+
+    size_t long_size        = take_number (input, sizeof (uint8_t));
+    size_t long_double_size = take_number (input, sizeof (uint8_t));
+    size_t pointer_size     = take_number (input, sizeof (uint8_t));
+    if (long_size != sizeof (long) || long_double_size != sizeof (long double) || pointer_size != sizeof (void*))
+    {
+        fprintf (stderr, "The log was written on a machine with other type sizes\n");
+        return -1;
+    }
+
+    struct log_site* sites = NULL;
+    size_t site_capacity = 0;
+
+    char text [header_max + message_max] = "";
+    time_t cached_seconds = -1;
+    struct tm now = {};
+    int result = 0;
+
+    while (!input->failed && input->position < input->size)
+    {
+        uint32_t id = (uint32_t) take_number (input, sizeof (uint32_t));
+        if (id == binary_log_site_definition)
+        {
+            result = take_site (input, &sites, &site_capacity);
+            if (result != 0)
+            {
+                break;
+            }
+            continue;
+        }
+
+        uint64_t time_ns    = take_number (input, sizeof (uint64_t));
+        enum LevelLog level = (enum LevelLog) take_number (input, sizeof (uint8_t));
+        size_t args_size    = take_number (input, sizeof (uint16_t));
+        const unsigned char* args = take (input, args_size);
+
+        const struct log_site* site = (id < site_capacity) ? &sites [id] : NULL;
+        if (input->failed || site == NULL || site->file == NULL)
+        {
+            input->failed = 1;
+            break;
+        }
+
+        time_t seconds = (time_t) (time_ns / 1000000000);
+        if (seconds != cached_seconds)
+        {
+            cached_seconds = seconds;
+            localtime_r (&cached_seconds, &now);
+        }
+
+        int length = format_log_header (text, header_max, site, level, &now);
+        length = (length < (int) header_max) ? length : (int) header_max - 1;
+        format_log_args (text + length, message_max, site->format, args, args_size);
+        fprintf (output, "%s\n\n", text);
+    }
+
+    free (sites);
+
+    if (input->failed)
+    {
+        fprintf (stderr, "The log is cut or damaged at byte %zu\n", input->position);
+        return -1;
+    }
+    return result;
+}
+
+int main (int argc, char* argv [])
+{
+    FILE* input  = (argc > 1) ? fopen (argv [1], "rb") : stdin;
+    FILE* output = (argc > 2) ? fopen (argv [2], "w")  : stdout;
+    if (input == NULL || output == NULL)
+    {
+        fprintf (stderr, "Can't open %s\n", (input == NULL) ? argv [1] : argv [2]);
+        return EXIT_FAILURE;
+    }
+
+    struct reader reader = {};
+    unsigned char* data = read_all (input, &reader.size);
+    if (data == NULL)
+    {
+        fprintf (stderr, "Can't read the log\n");
+        return EXIT_FAILURE;
+    }
+    reader.data = data;
+
+    int result = decode (&reader, output);
+
+    free (data);
+    if (input != stdin)
+    {
+        fclose (input);
+    }
+    if (output != stdout)
+    {
+        fclose (output);
+    }
+    return (result == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
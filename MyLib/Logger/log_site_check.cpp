@@ -0,0 +1,23 @@
+#include "logging.h"
+
+// Compile-only check built into log_decoder with DEBUG defined: LOG in inline and template
+// functions (COMDAT sites) has to build next to LOG in plain functions of the same file.
+// Nothing calls these functions.
+
+inline void log_check_inline (const int value)
+{
+    LOG (kDebug, "inline %d", value);
+}
+
+template <typename T>
+void log_check_template (const T value)
+{
+    LOG (kDebug, "template %d", (int) value);
+}
+
+void log_check_plain (const int value)
+{
+    LOG (kDebug, "plain %d", value);
+    log_check_inline (value);
+    log_check_template (value);
+}
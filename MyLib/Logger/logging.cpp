@@ -2,73 +2,262 @@
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <time.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+
 #include "logging.h"
+#include "log_args.h"
 #include "../Assert/my_assert.h"
 
-static enum LevelLog logging_lvl   = kWarning;
-static FILE* logging_stream        = stderr;
-static const int year_shift        = 1900;
-static const int month_shift       = 1;
+static const size_t cache_line_size     = 64;
+static const size_t record_size         = 256;
+static const size_t ring_capacity       = 1024;
+static const size_t message_max         = 4096;
+static const size_t header_max          = 512;
+static const size_t batch_size          = 64 * 1024;
+static const int    year_shift          = 1900;
+static const int    month_shift         = 1;
+static const size_t binary_record_fixed = sizeof (uint32_t) + sizeof (uint64_t) + sizeof (uint8_t) + sizeof (uint16_t);
+// Marker, id, line and three strings cut to header_max
+static const size_t binary_site_max     = 3 * sizeof (uint32_t) + 3 * (sizeof (uint16_t) + header_max);
+// A record that defines its site first
+static const size_t binary_record_max   = binary_site_max + binary_record_fixed + message_max;
+static_assert (binary_record_max >= header_max + message_max, "a text record has to fit where a binary one does");
+static const std::chrono::milliseconds writer_sleep (2);
+
+static std::atomic<enum LevelLog> logging_lvl (kWarning);
+
+struct log_record
+{
+    struct timespec time;
+
+    struct log_site* site;
+
+    enum LevelLog level;
+
+    uint16_t args_size;
 
-static void level_to_str (const enum LevelLog level);
+    unsigned char args [record_size - sizeof (struct timespec) - sizeof (struct log_site*)
+                        - sizeof (enum LevelLog) - sizeof (uint16_t)];
+};
 
-static void level_to_str (const enum LevelLog level)
+static_assert (sizeof (struct log_record) == record_size, "log_record has to stay record_size bytes");
+
+// One producer (the owning thread), one consumer (the writer)
+struct log_ring
+{
+    alignas (cache_line_size) std::atomic<size_t> head;
+
+    alignas (cache_line_size) std::atomic<size_t> tail;
+
+    std::atomic<size_t> dropped;
+
+    // Set when the owning thread exits, the writer frees the ring once it's empty
+    std::atomic<bool> orphaned;
+
+    struct log_ring* next;
+
+    struct log_record records [ring_capacity];
+};
+
+struct ring_owner
+{
+    struct log_ring* ring;
+
+    ~ring_owner ()
+    {
+        if (ring != NULL)
+        {
+            ring->orphaned.store (true, std::memory_order_release);
+        }
+    }
+};
+
+static thread_local struct ring_owner thread_ring = {};
+
+static std::atomic<bool>       async_enabled (false);
+static std::atomic<size_t>     dropped_total (0);
+struct log_output
+{
+    FILE* stream;
+
+    bool binary;
+
+    // Number of the binary log, sites are defined once in each
+    uint32_t generation;
+};
+
+// Guards the rings, the output and the binary ids of sites: the stream and its format change
+// together, and whoever writes a record holds it from reading the output to the write
+static std::mutex              rings_mutex;
+static struct log_ring*        rings = NULL;
+static struct log_output       logging_output = {stderr, false, 0};
+static uint32_t                binary_generation = 0;
+static uint32_t                site_count = 0;
+static std::atomic<bool>       writer_running (false);
+
+static std::mutex              flush_mutex;
+static std::condition_variable flush_cond;
+static uint64_t                flush_requested = 0;
+static uint64_t                flush_done      = 0;
+
+// Returning from main with a joinable std::thread terminates the program and loses the queue.
+// Defined after the statics the writer uses, so it's destroyed and stops the writer first.
+struct log_writer
+{
+    std::thread thread;
+
+    ~log_writer ()
+    {
+        stop_async_log ();
+    }
+};
+
+static struct log_writer writer;
+
+static const char*      level_to_str   (const enum LevelLog level);
+static struct log_output get_log_output (void);
+static void             set_log_output (FILE* const file, const bool binary);
+static size_t           append_record  (char* const buffer, const struct log_output* const output,
+                                        struct log_site* const site, const enum LevelLog level,
+                                        const struct timespec* const time, const struct tm* const now,
+                                        const unsigned char* const args, const size_t args_size);
+static struct log_ring* get_thread_ring (void);
+static void             push_record    (struct log_site* const site, const enum LevelLog level, va_list param);
+static size_t           drain_rings    (char* const batch, size_t* const batch_used);
+static void             writer_loop    (void);
+static unsigned char*   put_number     (unsigned char* buffer, uint64_t value, const size_t size);
+static unsigned char*   put_string     (unsigned char* buffer, const char* const string, const size_t max_length);
+static size_t           encode_record  (unsigned char* const buffer, const struct log_output* const output,
+                                        struct log_site* const site, const enum LevelLog level,
+                                        const struct timespec* const time,
+                                        const unsigned char* const args, const size_t args_size);
+
+static const char* level_to_str (const enum LevelLog level)
 {
     switch (level)
     {
         case kDebug:
         {
-            fprintf (logging_stream, "[%s] \n", "DEBUG");
-            break;
+            return "DEBUG";
         }
         case kInfo:
         {
-            fprintf (logging_stream, "[%s] \n", "INFO");
-            break;
+            return "INFO";
         }
         case kWarning:
         {
-            fprintf (logging_stream, "[%s] \n", "WARNING");
-            break;
+            return "WARNING";
         }
         case kError:
         {
-            fprintf (logging_stream, "[%s] \n", "ERROR");
-            break;
+            return "ERROR";
         }
         default:
         {
             ASSERT(0, "Program got wrong level of logging in function log\n");
-            break;
+            return "UNKNOWN";
         }
     }
 }
 
+int format_log_header (char* const buffer, const size_t size, const struct log_site* const site,
+                       const enum LevelLog level, const struct tm* const now)
+{
+    return snprintf (buffer, size, "[%s] \n%s:%d (%s) %d sec %d min %d hours %d days %d month %d year\n",
+                     level_to_str (level), site->file, site->line, site->func,
+                     now->tm_sec, now->tm_min, now->tm_hour, now->tm_mday,
+                     now->tm_mon + month_shift, now->tm_year + year_shift);
+}
 
-void Log (const struct logging settings, const enum LevelLog level, const char * const format, ...)
+// Whole record goes out in one fwrite: the stream is unbuffered
+void Log (struct log_site* const site, const enum LevelLog level, const char * const format, ...)
 {
+    ASSERT(site   != NULL, "Invalid argument for Log %p\n", site);
     ASSERT(format != NULL, "Invalid argument for Log %p\n", format);
 
-    if (level < logging_lvl)
+    if (level < logging_lvl.load (std::memory_order_relaxed))
     {
         return;
     }
 
-    level_to_str (level);
-    fprintf (logging_stream, "%s:%d (%s) %d sec %d min %d hours %d days %d month %d year\n",
-             settings.file, settings.line, settings.func,
-             settings.now->tm_sec, settings.now->tm_min,
-             settings.now->tm_hour, settings.now->tm_mday,
-             settings.now->tm_mon + month_shift, settings.now->tm_year + year_shift);
-
     va_list param;
     va_start (param, format);
-    vfprintf (logging_stream, format, param);
+
+    if (async_enabled.load (std::memory_order_acquire))
+    {
+        push_record (site, level, param);
+        va_end (param);
+        return;
+    }
+
+    struct log_output output = get_log_output ();
+    if (output.binary)
+    {
+        unsigned char args [message_max] = {};
+        size_t args_size = pack_log_args (args, sizeof (args), format, param);
+        va_end (param);
+
+        struct timespec time = {};
+        clock_gettime (CLOCK_REALTIME, &time);
+
+        // The output may have changed since the check, the record follows the current one
+        char record [binary_record_max] = "";
+        std::lock_guard<std::mutex> lock (rings_mutex);
+        size_t record_size = append_record (record, &logging_output, site, level, &time, NULL, args, args_size);
+        fwrite (record, sizeof (char), record_size, logging_output.stream);
+        return;
+    }
+
+    time_t seconds = time (NULL);
+    struct tm now = {};
+    localtime_r (&seconds, &now);
+
+    char  text [header_max + message_max] = "";
+    char* record = text;
+    int   header_length = format_log_header (text, header_max, site, level, &now);
+    header_length = (header_length < (int) header_max) ? header_length : (int) header_max - 1;
+
+    va_list copy;
+    va_copy (copy, param);
+    int message_length = vsnprintf (text + header_length, message_max, format, copy);
+    va_end (copy);
+
+    if (message_length >= (int) message_max - 2)
+    {
+        record = (char*) calloc (header_length + message_length + 3, sizeof (char));
+        if (record == NULL)
+        {
+            record = text;
+            message_length = message_max - 3;
+        }
+        else
+        {
+            memcpy (record, text, header_length);
+            vsnprintf (record + header_length, message_length + 1, format, param);
+        }
+    }
     va_end (param);
 
-    fprintf (logging_stream, "\n\n");
+    if (message_length < 0)
+    {
+        message_length = 0;
+    }
+    memcpy (record + header_length + message_length, "\n\n", 2);
+    fwrite (record, sizeof (char), header_length + message_length + 2, output.stream);
+
+    if (record != text)
+    {
+        free (record);
+    }
 }
 
 void set_log_lvl (const enum LevelLog level)
@@ -80,7 +269,334 @@ void set_log_file (FILE* const file)
 {
     if (file != NULL)
     {
-        logging_stream = file;
+        flush_log ();
         setbuf (file, NULL);
+        set_log_output (file, false);
+    }
+}
+
+static struct log_output get_log_output (void)
+{
+    std::lock_guard<std::mutex> lock (rings_mutex);
+    return logging_output;
+}
+
+static void set_log_output (FILE* const file, const bool binary)
+{
+    std::lock_guard<std::mutex> lock (rings_mutex);
+    logging_output.stream = file;
+    logging_output.binary = binary;
+    if (binary)
+    {
+        logging_output.generation = ++binary_generation;
+    }
+}
+
+// A record in the format of output, buffer has to hold binary_record_max bytes.
+// now is the local time of time, NULL if the caller doesn't have it.
+static size_t append_record (char* const buffer, const struct log_output* const output,
+                             struct log_site* const site, const enum LevelLog level,
+                             const struct timespec* const time, const struct tm* const now,
+                             const unsigned char* const args, const size_t args_size)
+{
+    if (output->binary)
+    {
+        return encode_record ((unsigned char*) buffer, output, site, level, time, args, args_size);
+    }
+
+    struct tm local_now = {};
+    if (now == NULL)
+    {
+        localtime_r (&time->tv_sec, &local_now);
+    }
+
+    int header_length = format_log_header (buffer, header_max, site, level, (now != NULL) ? now : &local_now);
+    header_length = (header_length < (int) header_max) ? header_length : (int) header_max - 1;
+
+    int message_length = format_log_args (buffer + header_length, message_max - 2, site->format, args, args_size);
+    message_length = (message_length < (int) message_max - 3) ? message_length : (int) message_max - 3;
+
+    memcpy (buffer + header_length + message_length, "\n\n", 2);
+    return header_length + message_length + 2;
+}
+
+//-----------------ASYNC MODE-------------------------------------------------------------------
+
+static struct log_ring* get_thread_ring (void)
+{
+    if (thread_ring.ring != NULL)
+    {
+        return thread_ring.ring;
+    }
+
+    struct log_ring* ring = new (std::nothrow) struct log_ring;
+    if (ring == NULL)
+    {
+        return NULL;
+    }
+    ring->head     = 0;
+    ring->tail     = 0;
+    ring->dropped  = 0;
+    ring->orphaned = false;
+
+    std::lock_guard<std::mutex> lock (rings_mutex);
+    ring->next = rings;
+    rings = ring;
+    thread_ring.ring = ring;
+
+    return ring;
+}
+
+static void push_record (struct log_site* const site, const enum LevelLog level, va_list param)
+{
+    struct log_ring* ring = get_thread_ring ();
+    if (ring == NULL)
+    {
+        dropped_total.fetch_add (1, std::memory_order_relaxed);
+        return;
     }
+
+    size_t tail = ring->tail.load (std::memory_order_relaxed);
+    if (tail - ring->head.load (std::memory_order_acquire) == ring_capacity)
+    {
+        ring->dropped.fetch_add (1, std::memory_order_relaxed);
+        return;
+    }
+
+    struct log_record* record = &ring->records [tail % ring_capacity];
+    clock_gettime (CLOCK_REALTIME, &record->time);
+    record->site      = site;
+    record->level     = level;
+    record->args_size = (uint16_t) pack_log_args (record->args, sizeof (record->args), site->format, param);
+
+    ring->tail.store (tail + 1, std::memory_order_release);
+}
+
+// Returns the number of records written, frees rings of finished threads
+static size_t drain_rings (char* const batch, size_t* const batch_used)
+{
+    static time_t    cached_seconds = -1;
+    static struct tm cached_now     = {};
+
+    size_t written = 0;
+
+    // Records and the final flush go to the output read under the same lock
+    std::lock_guard<std::mutex> lock (rings_mutex);
+    const struct log_output output = logging_output;
+    struct log_ring** link = &rings;
+    while (*link != NULL)
+    {
+        struct log_ring* ring = *link;
+        bool orphaned = ring->orphaned.load (std::memory_order_acquire);
+
+        size_t head = ring->head.load (std::memory_order_relaxed);
+        size_t tail = ring->tail.load (std::memory_order_acquire);
+        for (; head != tail; head++)
+        {
+            const struct log_record* record = &ring->records [head % ring_capacity];
+            if (record->time.tv_sec != cached_seconds)
+            {
+                cached_seconds = record->time.tv_sec;
+                localtime_r (&cached_seconds, &cached_now);
+            }
+
+            if (batch_size - *batch_used < binary_record_max)
+            {
+                fwrite (batch, sizeof (char), *batch_used, output.stream);
+                *batch_used = 0;
+            }
+
+            *batch_used += append_record (batch + *batch_used, &output, record->site, record->level,
+                                          &record->time, &cached_now, record->args, record->args_size);
+            written++;
+        }
+        ring->head.store (head, std::memory_order_release);
+
+        size_t dropped = ring->dropped.exchange (0, std::memory_order_relaxed);
+        dropped_total.fetch_add (dropped, std::memory_order_relaxed);
+
+        if (orphaned)
+        {
+            *link = ring->next;
+            delete ring;
+        }
+        else
+        {
+            link = &ring->next;
+        }
+    }
+
+    if (*batch_used > 0)
+    {
+        fwrite (batch, sizeof (char), *batch_used, output.stream);
+        fflush (output.stream);
+        *batch_used = 0;
+    }
+
+    return written;
+}
+
+static void writer_loop (void)
+{
+    char* batch = (char*) calloc (batch_size, sizeof (char));
+    ASSERT(batch != NULL, "Can't allocate the log batch buffer\n");
+    size_t batch_used = 0;
+
+    while (true)
+    {
+        bool running = writer_running.load (std::memory_order_acquire);
+
+        uint64_t ticket = 0;
+        {
+            std::lock_guard<std::mutex> lock (flush_mutex);
+            ticket = flush_requested;
+        }
+
+        size_t written = drain_rings (batch, &batch_used);
+
+        {
+            std::lock_guard<std::mutex> lock (flush_mutex);
+            flush_done = ticket;
+        }
+        flush_cond.notify_all ();
+
+        if (!running)
+        {
+            break;
+        }
+        if (written == 0)
+        {
+            std::this_thread::sleep_for (writer_sleep);
+        }
+    }
+
+    free (batch);
+}
+
+int start_async_log (void)
+{
+    if (async_enabled.load ())
+    {
+        return 0;
+    }
+
+    writer_running = true;
+    try
+    {
+        writer.thread = std::thread (writer_loop);
+    }
+    catch (const std::system_error&)
+    {
+        writer_running = false;
+        return -1;
+    }
+
+    async_enabled.store (true, std::memory_order_release);
+    return 0;
+}
+
+void stop_async_log (void)
+{
+    if (!async_enabled.load ())
+    {
+        return;
+    }
+
+    async_enabled.store (false, std::memory_order_release);
+    writer_running = false;
+    writer.thread.join ();
+}
+
+void flush_log (void)
+{
+    if (!async_enabled.load (std::memory_order_acquire))
+    {
+        fflush (get_log_output ().stream);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock (flush_mutex);
+    uint64_t ticket = ++flush_requested;
+    flush_cond.wait (lock, [ticket] {return flush_done >= ticket;});
+}
+
+size_t get_log_dropped (void)
+{
+    return dropped_total.load (std::memory_order_relaxed);
+}
+
+//-----------------BINARY MODE------------------------------------------------------------------
+
+static unsigned char* put_number (unsigned char* buffer, uint64_t value, const size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        *buffer++ = (unsigned char) (value >> (8 * i));
+    }
+    return buffer;
+}
+
+static unsigned char* put_string (unsigned char* buffer, const char* const string, const size_t max_length)
+{
+    size_t length = strnlen (string, max_length);
+    buffer = put_number (buffer, length, sizeof (uint16_t));
+    memcpy (buffer, string, length);
+    return buffer + length;
+}
+
+// Called under rings_mutex, which guards the site ids. A site gets its id on the first binary
+// record and is defined in a binary log right before its first record there.
+static size_t encode_record (unsigned char* const buffer, const struct log_output* const output,
+                             struct log_site* const site, const enum LevelLog level,
+                             const struct timespec* const time,
+                             const unsigned char* const args, const size_t args_size)
+{
+    unsigned char* position = buffer;
+
+    if (site->defined_in != output->generation)
+    {
+        if (site->id == 0)
+        {
+            site->id = ++site_count;
+        }
+        site->defined_in = output->generation;
+
+        position = put_number (position, binary_log_site_definition, sizeof (uint32_t));
+        position = put_number (position, site->id,   sizeof (uint32_t));
+        position = put_number (position, site->line, sizeof (uint32_t));
+        position = put_string (position, site->file,   header_max);
+        position = put_string (position, site->func,   header_max);
+        position = put_string (position, site->format, header_max);
+    }
+
+    position = put_number (position, site->id, sizeof (uint32_t));
+    position = put_number (position, (uint64_t) time->tv_sec * 1000000000 + time->tv_nsec, sizeof (uint64_t));
+    position = put_number (position, level, sizeof (uint8_t));
+    position = put_number (position, args_size, sizeof (uint16_t));
+
+    memcpy (position, args, args_size);
+    return position + args_size - buffer;
+}
+
+int start_binary_log (FILE* const file)
+{
+    ASSERT(file != NULL, "Invalid argument for start_binary_log %p\n", file);
+
+    flush_log ();
+
+    unsigned char header [sizeof (binary_log_magic) + sizeof (uint16_t) + 3 * sizeof (uint8_t)] = {};
+    unsigned char* position = header;
+    memcpy (position, binary_log_magic, sizeof (binary_log_magic));
+    position = put_number (position + sizeof (binary_log_magic), binary_log_version, sizeof (uint16_t));
+    position = put_number (position, sizeof (long),        sizeof (uint8_t));
+    position = put_number (position, sizeof (long double), sizeof (uint8_t));
+    position = put_number (position, sizeof (void*),       sizeof (uint8_t));
+
+    if (fwrite (header, sizeof (unsigned char), sizeof (header), file) != sizeof (header))
+    {
+        return -1;
+    }
+
+    set_log_output (file, true);
+    return 0;
 }
@@ -2,14 +2,22 @@
 #define LOGGING_H
 
 #include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <time.h>
 
+#define LOG_FORMAT_(format, ...) format
+
+// Every call site gets a static log_site; the "" makes a non-literal format a compile error,
+// async records keep only the site pointer. Binary logs give a site its id on first use, so
+// LOG works the same in inline functions, templates and other shared objects.
 #if (!(defined(NDEBUG)) && (defined(DEBUG)))
 #define LOG(level, ...)                                                                                  \
     do                                                                                                   \
     {                                                                                                    \
-        time_t seconds = time (NULL);                                                                    \
-        Log ({__FILE__, __func__, __LINE__, localtime(&seconds)}, level, __VA_ARGS__);                   \
+        static struct log_site log_site_ =                                                               \
+            {__FILE__, __func__, __LINE__, LOG_FORMAT_ ("" __VA_ARGS__, 0), 0, 0};                       \
+        Log (&log_site_, level, __VA_ARGS__);                                                            \
     } while (0)
 #else
 #define LOG(...)
@@ -23,7 +31,7 @@ enum LevelLog
     kError   = 4,
 };
 
-struct logging
+struct log_site
 {
     const char* const file;
 
@@ -31,11 +39,48 @@ struct logging
 
     int line;
 
-    struct tm *now;
+    const char* const format;
+
+    // Binary logs only, set by the logger under its lock: id in the process (0 until the
+    // first binary record) and the binary log the site was last defined in
+    uint32_t id;
+
+    uint32_t defined_in;
 };
 
+// Binary log: header "DR4L", uint16 version, uint8 sizes of long, long double and void*
+// (arguments are stored raw, so the decoder has to match them). Then entries starting with
+// a uint32 site id. Id binary_log_site_definition is followed by a site: uint32 id, uint32 line,
+// file, func, format as uint16 length + bytes, it comes before the first record of the site.
+// Other ids start a record: uint64 realtime nanoseconds, uint8 level, uint16 argument bytes
+// and the arguments packed by pack_log_args.
+// Fields are little-endian, arguments keep the layout of the writing machine.
+static const char     binary_log_magic [4]       = {'D', 'R', '4', 'L'};
+static const unsigned binary_log_version         = 2;
+static const uint32_t binary_log_site_definition = 0xffffffff;
+
 void set_log_lvl (const enum LevelLog level);
 void set_log_file (FILE* const file);
-void Log (const struct logging parameter, const enum LevelLog level, const char * const format, ...);
+void Log (struct log_site* const site, const enum LevelLog level, const char * const format, ...)
+    __attribute__ ((format (printf, 3, 4)));
+
+// Async mode: Log copies the timestamp, site and raw arguments into a lock-free ring of the
+// calling thread and returns, a writer thread formats the records and writes them in batches.
+// Records that don't fit into a full ring are dropped and counted. Returns 0 on success.
+int    start_async_log (void);
+// Writes what is queued and joins the writer, records other threads log meanwhile may be lost.
+// Also called when static objects are destroyed, so returning from main in async mode is fine.
+void   stop_async_log  (void);
+// Returns when everything logged before the call is written
+void   flush_log       (void);
+size_t get_log_dropped (void);
+
+// Writes the header to file and logs there in the binary format until set_log_file.
+// The stream keeps its buffering. Returns 0 on success.
+int    start_binary_log (FILE* const file);
+
+// Text header of a record, also used by log_decoder
+int    format_log_header (char* const buffer, const size_t size, const struct log_site* const site,
+                          const enum LevelLog level, const struct tm* const now);
 
 #endif // LOGGING_H
@@ -0,0 +1,94 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "frame_pacer.hpp"
+
+namespace bench {
+
+    // Every benchmark runs at least this long, iteration counts grow until it does
+    const double kMinBenchTime = 0.2;
+    const size_t kMaxIterations = (size_t)1 << 30;
+
+    template <typename T>
+    inline void DoNotOptimize(const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    struct Result {
+        std::string name;
+        size_t iterations;
+        double ns_per_op;
+        double items_per_second;
+    };
+
+    // Names given on the command line select benchmarks by substring, none means all
+    class Runner {
+        private:
+            std::vector<std::string> filters_;
+            std::vector<Result> results_;
+
+        public:
+            explicit Runner(const std::vector<std::string>& filters)
+                :filters_(filters), results_() {};
+
+            bool IsSelected(const char* name) const {
+                if (filters_.empty()) {
+                    return true;
+                }
+                for (const std::string& filter : filters_) {
+                    if (strstr(name, filter.c_str()) != NULL) {
+                        return true;
+                    }
+                }
+                return false;
+            };
+
+            // body(iterations) runs the operation iterations times, each one handles
+            // items_per_op items (pixels, events...)
+            template <typename Body>
+            void Run(const char* name, size_t items_per_op, Body body) {
+                if (!IsSelected(name)) {
+                    return;
+                }
+
+                // Warm-up: caches, lazily created GL objects, glyph atlases
+                body(1);
+
+                size_t iterations = 1;
+                double elapsed = 0;
+                while (true) {
+                    uint64_t start = graphics::MonotonicNanoseconds();
+                    body(iterations);
+                    elapsed = (graphics::MonotonicNanoseconds() - start) * 1e-9;
+
+                    if (elapsed >= kMinBenchTime || iterations >= kMaxIterations) {
+                        break;
+                    }
+                    double scale = (elapsed > 0) ? kMinBenchTime * 1.2 / elapsed : 100;
+                    iterations = (size_t)(iterations * ((scale < 100) ? ((scale > 2) ? scale : 2) : 100));
+                }
+
+                Result result = {name, iterations, elapsed * 1e9 / iterations,
+                                 (double)iterations * items_per_op / elapsed};
+                printf("%-32s %12zu %14.1f %16.0f\n", result.name.c_str(), result.iterations,
+                       result.ns_per_op, result.items_per_second);
+                fflush(stdout);
+                results_.push_back(result);
+            };
+
+            static void PrintHeader() {
+                printf("%-32s %12s %14s %16s\n", "benchmark", "iterations", "ns/op", "items/s");
+            };
+
+            const std::vector<Result>& GetResults() const {return results_;};
+    };
+
+};
+
+#endif // BENCH_HPP
@@ -0,0 +1,307 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "graphics.hpp"
+#include "bench.hpp"
+
+#include "../geometry/include/vector.hpp"
+
+// Usage: micro_bench [--offscreen] [--font path] [name filters...]
+// DR4_BACKEND_OFFSCREEN=1 works too, so it can run on a machine without a display.
+
+static const char* const kDefaultFontPath = "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf";
+
+static const float kBenchTextureSize = 512;
+static const unsigned kBenchImageSize = 64;
+
+// Draws are batched and executed by the GPU later: resolve the texture and read one
+// pixel back, so the measured time covers the rendering itself
+static void SyncTexture(graphics::Texture& texture) {
+    sf::Uint8 pixel[4] = {};
+    texture.ReadPixels({{0, 0}, {1, 1}}, pixel);
+    bench::DoNotOptimize(pixel);
+}
+
+static void BenchPrimitives(bench::Runner& runner, graphics::Texture& target, const dr4::Font* font) {
+    graphics::Line line;
+    line.SetStart({10, 10});
+    line.SetEnd({300, 200});
+    line.SetColor({255, 0, 0, 255});
+    line.SetThickness(2);
+    runner.Run("Line::DrawOn", 1, [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; i++) {
+            line.DrawOn(target);
+        }
+        SyncTexture(target);
+    });
+
+    graphics::Circle circle;
+    circle.SetCenter({100, 100});
+    circle.SetRadius({40, 30});
+    circle.SetFillColor({0, 255, 0, 255});
+    circle.SetBorderColor({0, 0, 0, 255});
+    circle.SetBorderThickness(2);
+    runner.Run("Circle::DrawOn", 1, [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; i++) {
+            circle.DrawOn(target);
+        }
+        SyncTexture(target);
+    });
+
+    graphics::RectangleShape rectangle;
+    rectangle.SetPos({20, 20});
+    rectangle.SetSize({120, 40});
+    rectangle.SetFillColor({0, 0, 255, 255});
+    rectangle.SetBorderColor({255, 255, 255, 255});
+    rectangle.SetBorderThickness(1);
+    runner.Run("RectangleShape::DrawOn", 1, [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; i++) {
+            rectangle.DrawOn(target);
+        }
+        SyncTexture(target);
+    });
+
+    if (font != NULL) {
+        graphics::Text text;
+        text.SetFont(font);
+        text.SetFontSize(16);
+        text.SetText("The quick brown fox jumps over the lazy dog");
+        text.SetColor({255, 255, 255, 255});
+        text.SetPos({10, 100});
+        runner.Run("Text::DrawOn", 1, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; i++) {
+                text.DrawOn(target);
+            }
+            SyncTexture(target);
+        });
+    } else {
+        fprintf(stderr, "No font, Text benchmarks are skipped\n");
+    }
+
+    graphics::Image image(kBenchImageSize, kBenchImageSize);
+    runner.Run("Image::DrawOn", 1, [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; i++) {
+            image.DrawOn(target);
+        }
+        SyncTexture(target);
+    });
+
+    // Every draw re-uploads one dirty pixel
+    runner.Run("Image::DrawOn/dirty", 1, [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; i++) {
+            image.SetPixel(i % kBenchImageSize, 0, {(uint8_t)i, 0, 0, 255});
+            image.DrawOn(target);
+        }
+        SyncTexture(target);
+    });
+
+    graphics::Texture nested(kBenchImageSize, kBenchImageSize);
+    nested.Clear({40, 40, 40, 255});
+    runner.Run("Texture::DrawOn", 1, [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; i++) {
+            nested.DrawOn(target);
+        }
+        SyncTexture(target);
+    });
+
+    // Nested texture changes every frame, so each draw resolves it
+    runner.Run("Texture::DrawOn/resolve", 1, [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; i++) {
+            rectangle.DrawOn(nested);
+            nested.DrawOn(target);
+        }
+        SyncTexture(target);
+    });
+}
+
+static void BenchPixels(bench::Runner& runner, graphics::Texture& target) {
+    graphics::Image image(kBenchImageSize, kBenchImageSize);
+    const size_t pixels = (size_t)kBenchImageSize * kBenchImageSize;
+
+    runner.Run("Image::SetPixel", pixels, [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; i++) {
+            for (unsigned y = 0; y < kBenchImageSize; y++) {
+                for (unsigned x = 0; x < kBenchImageSize; x++) {
+                    image.SetPixel(x, y, {(uint8_t)x, (uint8_t)y, (uint8_t)i, 255});
+                }
+            }
+        }
+    });
+
+    runner.Run("Image::GetPixel", pixels, [&](size_t iterations) {
+        unsigned sum = 0;
+        for (size_t i = 0; i < iterations; i++) {
+            for (unsigned y = 0; y < kBenchImageSize; y++) {
+                for (unsigned x = 0; x < kBenchImageSize; x++) {
+                    sum += image.GetPixel(x, y).r;
+                }
+            }
+        }
+        bench::DoNotOptimize(sum);
+    });
+
+    const size_t target_pixels = (size_t)target.GetWidth() * (size_t)target.GetHeight();
+    runner.Run("Texture::GetImage", target_pixels, [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; i++) {
+            std::unique_ptr<dr4::Image> copy(target.GetImage());
+            bench::DoNotOptimize(copy);
+        }
+    });
+}
+
+namespace graphics {
+
+    struct RenderWindowBench {
+        static dr4::Event TranslateEvent(RenderWindow& window, const sf::Event& sf_event) {
+            return window.TranslateEvent(sf_event);
+        }
+    };
+
+}
+
+static void BenchEvents(bench::Runner& runner, graphics::RenderWindow& window) {
+    sf::Event mouse_move = {};
+    mouse_move.type = sf::Event::MouseMoved;
+    mouse_move.mouseMove.x = 10;
+    mouse_move.mouseMove.y = 20;
+
+    sf::Event key_press = {};
+    key_press.type = sf::Event::KeyPressed;
+    key_press.key.code = sf::Keyboard::A;
+    key_press.key.scancode = sf::Keyboard::Scan::A;
+
+    sf::Event text_entered = {};
+    text_entered.type = sf::Event::TextEntered;
+    text_entered.text.unicode = 'a';
+
+    sf::Event resized = {};
+    resized.type = sf::Event::Resized;
+
+    const sf::Event mix[] = {mouse_move, key_press, text_entered, resized};
+    const size_t mix_size = sizeof(mix) / sizeof(mix[0]);
+
+    runner.Run("PollEvent/translate mouse move", 1, [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; i++) {
+            dr4::Event event = graphics::RenderWindowBench::TranslateEvent(window, mouse_move);
+            bench::DoNotOptimize(event);
+        }
+    });
+
+    runner.Run("PollEvent/translate key", 1, [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; i++) {
+            dr4::Event event = graphics::RenderWindowBench::TranslateEvent(window, key_press);
+            bench::DoNotOptimize(event);
+        }
+    });
+
+    runner.Run("PollEvent/translate mix", mix_size, [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; i++) {
+            for (const sf::Event& sf_event : mix) {
+                dr4::Event event = graphics::RenderWindowBench::TranslateEvent(window, sf_event);
+                bench::DoNotOptimize(event);
+            }
+        }
+    });
+
+    if (window.IsOffscreen()) {
+        dr4::Event injected = graphics::RenderWindowBench::TranslateEvent(window, key_press);
+        runner.Run("PollEvent/injected", 1, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; i++) {
+                window.PushEvent(injected);
+                std::optional<dr4::Event> event = window.PollEvent();
+                bench::DoNotOptimize(event);
+            }
+        });
+
+        const size_t batch = 64;
+        std::vector<dr4::Event> events(batch);
+        runner.Run("PollEvents/injected batch", batch, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; i++) {
+                for (size_t j = 0; j < batch; j++) {
+                    window.PushEvent(injected);
+                }
+                size_t count = window.PollEvents(events.data(), batch);
+                bench::DoNotOptimize(count);
+            }
+        });
+    }
+}
+
+static void BenchGeometry(bench::Runner& runner) {
+    Coordinates a(3, 1, 2, 3);
+    Coordinates b(3, 4, 5, 6);
+
+    runner.Run("Coordinates arithmetic", 1, [&](size_t iterations) {
+        Coordinates sum(3);
+        for (size_t i = 0; i < iterations; i++) {
+            sum = sum + (a * 0.5f - b) / 3.f;
+            bench::DoNotOptimize(sum);
+        }
+    });
+
+    runner.Run("Coordinates dot/cross/normalize", 1, [&](size_t iterations) {
+        float dot = 0;
+        for (size_t i = 0; i < iterations; i++) {
+            Coordinates cross(a || b);
+            Coordinates normal(!cross);
+            dot += normal && a;
+            bench::DoNotOptimize(dot);
+        }
+    });
+
+    runner.Run("MyVector::Rotate", 1, [&](size_t iterations) {
+        MyVector vector(Coordinates(2, 0, 0), Coordinates(2, 10, 0));
+        for (size_t i = 0; i < iterations; i++) {
+            vector.Rotate(kRotationAngle);
+        }
+        bench::DoNotOptimize(vector);
+    });
+}
+
+int main(int argc, char* argv[]) {
+    bool offscreen = graphics::IsOffscreenRequested();
+    const char* font_path = kDefaultFontPath;
+    std::vector<std::string> filters;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--offscreen") == 0) {
+            offscreen = true;
+        } else if (strcmp(argv[i], "--font") == 0 && i + 1 < argc) {
+            font_path = argv[++i];
+        } else {
+            filters.push_back(argv[i]);
+        }
+    }
+
+    graphics::RenderWindow window(kBenchTextureSize, kBenchTextureSize, "micro_bench");
+    window.SetOffscreen(offscreen);
+    window.Open();
+
+    graphics::Font font;
+    const dr4::Font* loaded_font = NULL;
+    try {
+        font.LoadFromFile(font_path);
+        loaded_font = &font;
+    } catch (const std::runtime_error& error) {
+        fprintf(stderr, "%s: %s\n", font_path, error.what());
+    }
+
+    graphics::Texture target(kBenchTextureSize, kBenchTextureSize);
+
+    printf("%s path\n", offscreen ? "Offscreen" : "Window");
+    bench::Runner::PrintHeader();
+
+    bench::Runner runner(filters);
+    BenchPrimitives(runner, target, loaded_font);
+    BenchPixels(runner, target);
+    BenchEvents(runner, window);
+    BenchGeometry(runner);
+
+    window.Close();
+    return 0;
+}
@@ -0,0 +1,390 @@
+#include "scene.hpp"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <stdexcept>
+
+namespace scene {
+
+    static const float kDefaultSceneWidth = 1280;
+    static const float kDefaultSceneHeight = 720;
+
+    static const char* const kFrameName = "window";
+
+//-----------------PARSER-------------------------------------------------------------------------------------
+
+    static std::runtime_error ScriptError(const std::string& path, int line, const std::string& message) {
+        return std::runtime_error(path + ":" + std::to_string(line) + ": " + message);
+    }
+
+    // Splits a line into words, "quoted strings" stay one word without the quotes
+    static std::vector<std::string> SplitWords(const std::string& line) {
+        std::vector<std::string> words;
+        size_t pos = 0;
+        while (pos < line.size()) {
+            if (isspace((unsigned char)line[pos])) {
+                pos++;
+                continue;
+            }
+            if (line[pos] == '#' && (pos + 1 >= line.size() || !isxdigit((unsigned char)line[pos + 1]))) {
+                break;
+            }
+            if (line[pos] == '"') {
+                size_t end = line.find('"', pos + 1);
+                if (end == std::string::npos) {
+                    end = line.size();
+                }
+                words.push_back(line.substr(pos + 1, end - pos - 1));
+                pos = end + 1;
+                continue;
+            }
+            size_t end = pos;
+            while (end < line.size() && !isspace((unsigned char)line[end])) {
+                end++;
+            }
+            words.push_back(line.substr(pos, end - pos));
+            pos = end;
+        }
+        return words;
+    }
+
+    class Parser {
+        private:
+            Script& script_;
+            std::vector<std::string> words_;
+            int line_;
+
+            std::runtime_error Error(const std::string& message) const {
+                return ScriptError(script_.path, line_, message);
+            };
+
+            void ExpectArgs(size_t min_count, size_t max_count) const {
+                size_t count = words_.size() - 1;
+                if (count < min_count || count > max_count) {
+                    throw Error("wrong number of arguments for " + words_[0]);
+                }
+            };
+
+            float Number(size_t index) const {
+                char* end = NULL;
+                float value = strtof(words_[index].c_str(), &end);
+                if (end == words_[index].c_str() || *end != '\0') {
+                    throw Error("expected a number, got " + words_[index]);
+                }
+                return value;
+            };
+
+            dr4::Color ParseColor(size_t index) const {
+                const std::string& word = words_[index];
+                if (word[0] != '#' || (word.size() != 7 && word.size() != 9)) {
+                    throw Error("expected #rrggbb or #rrggbbaa, got " + word);
+                }
+                unsigned long value = strtoul(word.c_str() + 1, NULL, 16);
+                if (word.size() == 7) {
+                    value = (value << 8) | 0xff;
+                }
+                return dr4::Color((value >> 24) & 0xff, (value >> 16) & 0xff, (value >> 8) & 0xff, value & 0xff);
+            };
+
+            void CheckName(const std::string& name, bool images_allowed) const {
+                if (name == kFrameName) {
+                    return;
+                }
+                auto resource = script_.resources.find(name);
+                if (resource == script_.resources.end()) {
+                    throw Error("unknown texture or image " + name);
+                }
+                if (resource->second.is_image && !images_allowed) {
+                    throw Error(name + " is an image, not a texture");
+                }
+            };
+
+            void Declare(bool is_image) {
+                ExpectArgs(3, 3);
+                if (words_[1] == kFrameName || script_.resources.count(words_[1]) != 0) {
+                    throw Error("redefinition of " + words_[1]);
+                }
+                script_.resources[words_[1]] = {is_image, Number(2), Number(3)};
+            };
+
+            // X Y W H FILL [BORDER THICKNESS], thickness goes last into args
+            Command Shape(CommandType type) {
+                ExpectArgs(5, 7);
+                if (words_.size() == 7) {
+                    throw Error("border color without thickness");
+                }
+
+                Command command = {};
+                command.type = type;
+                command.line = line_;
+                command.args = {Number(1), Number(2), Number(3), Number(4), 0};
+                command.color = ParseColor(5);
+                command.border_color = command.color;
+                if (words_.size() == 8) {
+                    command.border_color = ParseColor(6);
+                    command.args[4] = Number(7);
+                }
+                return command;
+            };
+
+        public:
+            explicit Parser(Script& script)
+                :script_(script), words_(), line_(0) {};
+
+            // Returns false on "end" of a repeat block or at the end of input
+            bool ParseBlock(std::istream& input, std::vector<Command>& commands, bool nested) {
+                std::string text;
+                while (std::getline(input, text)) {
+                    line_++;
+                    words_ = SplitWords(text);
+                    if (words_.empty()) {
+                        continue;
+                    }
+
+                    const std::string& name = words_[0];
+                    Command command = {};
+                    command.line = line_;
+
+                    if (name == "end") {
+                        if (!nested) {
+                            throw Error("end without repeat");
+                        }
+                        return true;
+                    } else if (name == "size") {
+                        ExpectArgs(2, 2);
+                        script_.width = Number(1);
+                        script_.height = Number(2);
+                        continue;
+                    } else if (name == "texture" || name == "image") {
+                        Declare(name == "image");
+                        continue;
+                    } else if (name == "target") {
+                        ExpectArgs(1, 1);
+                        CheckName(words_[1], false);
+                        command.type = CommandType::TARGET;
+                        command.name = words_[1];
+                    } else if (name == "clear") {
+                        ExpectArgs(1, 1);
+                        command.type = CommandType::CLEAR;
+                        command.color = ParseColor(1);
+                    } else if (name == "clip") {
+                        ExpectArgs(4, 4);
+                        command.type = CommandType::CLIP;
+                        for (size_t i = 1; i <= 4; i++) {
+                            command.args.push_back(Number(i));
+                        }
+                    } else if (name == "noclip") {
+                        ExpectArgs(0, 0);
+                        command.type = CommandType::NO_CLIP;
+                    } else if (name == "rect") {
+                        command = Shape(CommandType::RECT);
+                    } else if (name == "circle") {
+                        command = Shape(CommandType::CIRCLE);
+                    } else if (name == "line") {
+                        ExpectArgs(6, 6);
+                        command.type = CommandType::LINE;
+                        command.args = {Number(1), Number(2), Number(3), Number(4), Number(6)};
+                        command.color = ParseColor(5);
+                    } else if (name == "text") {
+                        ExpectArgs(5, 5);
+                        command.type = CommandType::TEXT;
+                        command.args = {Number(1), Number(2), Number(3)};
+                        command.color = ParseColor(4);
+                        command.name = words_[5];
+                    } else if (name == "heatmap") {
+                        ExpectArgs(1, 1);
+                        CheckName(words_[1], true);
+                        auto resource = script_.resources.find(words_[1]);
+                        if (resource == script_.resources.end() || !resource->second.is_image) {
+                            throw Error(words_[1] + " is not an image");
+                        }
+                        command.type = CommandType::HEATMAP;
+                        command.name = words_[1];
+                    } else if (name == "draw") {
+                        ExpectArgs(3, 3);
+                        CheckName(words_[1], true);
+                        if (words_[1] == kFrameName) {
+                            throw Error("the window texture can't be drawn on itself");
+                        }
+                        command.type = CommandType::DRAW;
+                        command.name = words_[1];
+                        command.args = {Number(2), Number(3)};
+                    } else if (name == "repeat") {
+                        ExpectArgs(3, 3);
+                        command.type = CommandType::REPEAT;
+                        command.count = (size_t)Number(1);
+                        command.args = {Number(2), Number(3)};
+                        int start_line = line_;
+                        if (!ParseBlock(input, command.body, true)) {
+                            throw ScriptError(script_.path, start_line, "repeat without end");
+                        }
+                    } else {
+                        throw Error("unknown command " + name);
+                    }
+
+                    commands.push_back(std::move(command));
+                }
+                return false;
+            };
+    };
+
+    Script LoadScript(const std::string& path) {
+        std::ifstream input(path);
+        if (!input) {
+            throw std::runtime_error("Can't open scene " + path);
+        }
+
+        Script script = {path, kDefaultSceneWidth, kDefaultSceneHeight, {}, {}};
+        Parser parser(script);
+        parser.ParseBlock(input, script.commands, false);
+        return script;
+    }
+
+//-----------------PLAYER-------------------------------------------------------------------------------------
+
+    Player::Player(const Script& script, dr4::Window& window, const dr4::Font* font)
+        :script_(script), window_(window), font_(font), textures_(), images_(), frame_(NULL),
+         rectangle_(window.CreateRectangle()), circle_(window.CreateCircle()),
+         line_(window.CreateLine()), text_(window.CreateText()), frame_index_(0) {
+        frame_ = window.CreateTexture();
+        frame_->SetSize({script.width, script.height});
+        textures_[kFrameName] = frame_;
+
+        for (const auto& resource : script.resources) {
+            dr4::Vec2f size = {resource.second.width, resource.second.height};
+            if (resource.second.is_image) {
+                dr4::Image* image = window.CreateImage();
+                image->SetSize(size);
+                images_[resource.first] = image;
+            } else {
+                dr4::Texture* texture = window.CreateTexture();
+                texture->SetSize(size);
+                textures_[resource.first] = texture;
+            }
+        }
+
+        if (font_ != NULL) {
+            text_->SetFont(font_);
+        }
+    }
+
+    Player::~Player() {
+        for (auto& texture : textures_) {
+            delete texture.second;
+        }
+        for (auto& image : images_) {
+            delete image.second;
+        }
+        delete rectangle_;
+        delete circle_;
+        delete line_;
+        delete text_;
+    }
+
+    // Cheap per-pixel pattern, so the cost is in SetPixel and the upload
+    void Player::Heatmap(dr4::Image& image) const {
+        size_t width = image.GetWidth();
+        size_t height = image.GetHeight();
+        for (size_t y = 0; y < height; y++) {
+            for (size_t x = 0; x < width; x++) {
+                uint8_t value = (uint8_t)(x * 3 + y * 5 + frame_index_ * 4);
+                image.SetPixel(x, y, dr4::Color(value, 255 - value, (uint8_t)(value * value >> 8), 255));
+            }
+        }
+    }
+
+    void Player::Run(const std::vector<Command>& commands, dr4::Texture*& target, float dx, float dy) {
+        for (const Command& command : commands) {
+            const std::vector<float>& args = command.args;
+
+            switch (command.type) {
+                case CommandType::TARGET : {
+                    target = textures_[command.name];
+                    break;
+                }
+                case CommandType::CLEAR : {
+                    target->Clear(command.color);
+                    break;
+                }
+                case CommandType::CLIP : {
+                    target->SetClipRect({{args[0] + dx, args[1] + dy}, {args[2], args[3]}});
+                    break;
+                }
+                case CommandType::NO_CLIP : {
+                    target->RemoveClipRect();
+                    break;
+                }
+                case CommandType::RECT : {
+                    rectangle_->SetPos({args[0] + dx, args[1] + dy});
+                    rectangle_->SetSize({args[2], args[3]});
+                    rectangle_->SetFillColor(command.color);
+                    rectangle_->SetBorderColor(command.border_color);
+                    rectangle_->SetBorderThickness(args[4]);
+                    rectangle_->DrawOn(*target);
+                    break;
+                }
+                case CommandType::CIRCLE : {
+                    circle_->SetCenter({args[0] + dx, args[1] + dy});
+                    circle_->SetRadius({args[2], args[3]});
+                    circle_->SetFillColor(command.color);
+                    circle_->SetBorderColor(command.border_color);
+                    circle_->SetBorderThickness(args[4]);
+                    circle_->DrawOn(*target);
+                    break;
+                }
+                case CommandType::LINE : {
+                    line_->SetStart({args[0] + dx, args[1] + dy});
+                    line_->SetEnd({args[2] + dx, args[3] + dy});
+                    line_->SetColor(command.color);
+                    line_->SetThickness(args[4]);
+                    line_->DrawOn(*target);
+                    break;
+                }
+                case CommandType::TEXT : {
+                    if (font_ == NULL) {
+                        break;
+                    }
+                    text_->SetPos({args[0] + dx, args[1] + dy});
+                    text_->SetFontSize(args[2]);
+                    text_->SetColor(command.color);
+                    text_->SetText(command.name);
+                    text_->DrawOn(*target);
+                    break;
+                }
+                case CommandType::HEATMAP : {
+                    Heatmap(*images_[command.name]);
+                    break;
+                }
+                case CommandType::DRAW : {
+                    auto image = images_.find(command.name);
+                    dr4::Drawable* drawable = (image != images_.end())
+                                            ? (dr4::Drawable*)image->second
+                                            : (dr4::Drawable*)textures_[command.name];
+                    drawable->SetPos({args[0] + dx, args[1] + dy});
+                    drawable->DrawOn(*target);
+                    break;
+                }
+                case CommandType::REPEAT : {
+                    for (size_t i = 0; i < command.count; i++) {
+                        Run(command.body, target, dx + args[0] * i, dy + args[1] * i);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    void Player::DrawFrame() {
+        window_.Clear(dr4::Color(0, 0, 0, 255));
+
+        dr4::Texture* target = frame_;
+        frame_->RemoveClipRect();
+        Run(script_.commands, target, 0, 0);
+
+        window_.Draw(*frame_);
+        frame_index_++;
+    }
+
+}
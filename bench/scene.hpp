@@ -0,0 +1,111 @@
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include <stdlib.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dr4/math/color.hpp"
+#include "dr4/texture.hpp"
+#include "dr4/window.hpp"
+
+// Scene scripts: one command per line, '#' starts a comment, colors are #rrggbb or #rrggbbaa.
+//
+//   size W H                       window size, before anything else
+//   texture NAME W H               offscreen texture, "window" is the frame itself
+//   image NAME W H                 image, pixels are rewritten by heatmap
+//   target NAME                    texture the following commands draw on
+//   clear COLOR
+//   clip X Y W H  /  noclip
+//   rect X Y W H FILL [BORDER THICKNESS]
+//   circle X Y RX RY FILL [BORDER THICKNESS]
+//   line X1 Y1 X2 Y2 COLOR THICKNESS
+//   text X Y SIZE COLOR "string"
+//   heatmap NAME                   rewrites every pixel of an image, differs per frame
+//   draw NAME X Y                  draws a texture or an image on the target
+//   repeat N DX DY ... end         runs the body N times, shifting positions by (DX, DY)
+namespace scene {
+
+    enum class CommandType {
+        TARGET,
+        CLEAR,
+        CLIP,
+        NO_CLIP,
+        RECT,
+        CIRCLE,
+        LINE,
+        TEXT,
+        HEATMAP,
+        DRAW,
+        REPEAT,
+    };
+
+    struct Command {
+        CommandType type;
+        int line;
+
+        std::vector<float> args;
+        dr4::Color color;
+        dr4::Color border_color;
+        // Target, texture or image name, or the text string
+        std::string name;
+
+        size_t count;
+        std::vector<Command> body;
+    };
+
+    struct Resource {
+        bool is_image;
+        float width;
+        float height;
+    };
+
+    struct Script {
+        std::string path;
+        float width;
+        float height;
+        std::unordered_map<std::string, Resource> resources;
+        std::vector<Command> commands;
+    };
+
+    // Throws std::runtime_error with the line number on syntax errors
+    Script LoadScript(const std::string& path);
+
+    // Objects the script refers to, created through the dr4::Window interface
+    class Player {
+        private:
+            const Script& script_;
+            dr4::Window& window_;
+            const dr4::Font* font_;
+
+            std::unordered_map<std::string, dr4::Texture*> textures_;
+            std::unordered_map<std::string, dr4::Image*> images_;
+            dr4::Texture* frame_;
+
+            dr4::Rectangle* rectangle_;
+            dr4::Circle* circle_;
+            dr4::Line* line_;
+            dr4::Text* text_;
+
+            size_t frame_index_;
+
+            void Run(const std::vector<Command>& commands, dr4::Texture*& target, float dx, float dy);
+            void Heatmap(dr4::Image& image) const;
+
+        public:
+            explicit Player(const Script& script, dr4::Window& window, const dr4::Font* font);
+
+            Player(const Player& other) = delete;
+            Player& operator=(const Player& other) = delete;
+
+            ~Player();
+
+            // Clears the window, runs the script and draws the frame texture on the window,
+            // Display() is left to the caller
+            void DrawFrame();
+    };
+
+};
+
+#endif // SCENE_HPP
@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "graphics.hpp"
+#include "scene.hpp"
+
+// Usage: scene_bench [--offscreen] [--frames N] [--warmup N] [--font path] [--no-readback] scenes...
+// Offscreen frames are read back by default like a real frame consumer would,
+// otherwise the GPU work of the last frames isn't waited for.
+// Every scene runs in a forked child, so its peak RSS doesn't include the scenes before it.
+
+static const char* const kDefaultFontPath = "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf";
+
+static const size_t kDefaultFrames = 300;
+static const size_t kDefaultWarmupFrames = 30;
+
+struct Options {
+    bool offscreen;
+    bool readback;
+    size_t frames;
+    size_t warmup;
+    const char* font_path;
+    std::vector<std::string> scenes;
+};
+
+// Nearest-rank percentile of sorted samples
+static double Percentile(const std::vector<double>& sorted, double percent) {
+    size_t rank = (size_t)(percent / 100 * sorted.size() + 0.999999);
+    return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+// Exit codes of the child that runs a scene
+enum SceneResult {
+    kSceneDone = 0,
+    kSceneFailed = 1,
+    // No frames were measured, no row was printed
+    kSceneEmpty = 2,
+};
+
+static void PrintHeader() {
+    printf("%-28s %7s %8s %8s %8s %8s %8s %10s %12s %10s\n", "scene", "frames", "mean", "p50", "p95",
+           "p99", "max", "draws", "vertices", "peak RSS");
+    printf("%-28s %7s %8s %8s %8s %8s %8s %10s %12s %10s\n", "", "", "ms", "ms", "ms", "ms", "ms",
+           "per frame", "per frame", "MiB");
+}
+
+// Prints the row without the peak RSS, the parent adds it when the child exits
+static SceneResult RunScene(const Options& options, const std::string& path) {
+    scene::Script script = scene::LoadScript(path);
+
+    graphics::RenderWindow window(script.width, script.height, "scene_bench");
+    window.SetOffscreen(options.offscreen);
+    if (options.offscreen && options.readback) {
+        window.SetFrameSink([](const sf::Uint8*, unsigned, unsigned) {});
+    }
+    window.Open();
+
+    dr4::Font* font = window.CreateFont();
+    const dr4::Font* loaded_font = font;
+    try {
+        font->LoadFromFile(options.font_path);
+    } catch (const std::runtime_error& error) {
+        fprintf(stderr, "%s: %s, text is skipped\n", options.font_path, error.what());
+        loaded_font = NULL;
+    }
+
+    std::vector<double> frame_times;
+    frame_times.reserve(options.frames);
+    size_t draw_calls = 0;
+    size_t vertices = 0;
+
+    {
+        scene::Player player(script, window, loaded_font);
+        for (size_t frame = 0; frame < options.warmup + options.frames; frame++) {
+            uint64_t start = graphics::MonotonicNanoseconds();
+            player.DrawFrame();
+            window.Display();
+            uint64_t end = graphics::MonotonicNanoseconds();
+
+            if (frame < options.warmup) {
+                continue;
+            }
+            frame_times.push_back((end - start) * 1e-6);
+            const graphics::FrameStats& stats = window.GetFrameStats();
+            draw_calls += stats.draw_calls;
+            vertices += stats.vertices;
+        }
+    }
+
+    delete font;
+    window.Close();
+
+    if (frame_times.empty()) {
+        return kSceneEmpty;
+    }
+
+    double total = 0;
+    for (double time : frame_times) {
+        total += time;
+    }
+    std::sort(frame_times.begin(), frame_times.end());
+
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    printf("%-28s %7zu %8.3f %8.3f %8.3f %8.3f %8.3f %10zu %12zu ", name.c_str(), frame_times.size(),
+           total / frame_times.size(), Percentile(frame_times, 50), Percentile(frame_times, 95),
+           Percentile(frame_times, 99), frame_times.back(), draw_calls / frame_times.size(),
+           vertices / frame_times.size());
+    fflush(stdout);
+    return kSceneDone;
+}
+
+// The parent never opens a window, so the child starts without GL or X state.
+// ru_maxrss of the child is in kilobytes on Linux.
+static bool RunSceneProcess(const Options& options, const std::string& path) {
+    fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) {
+        fprintf(stderr, "Can't fork for %s\n", path.c_str());
+        return false;
+    }
+
+    if (child == 0) {
+        SceneResult result = kSceneFailed;
+        try {
+            result = RunScene(options, path);
+        } catch (const std::runtime_error& error) {
+            fprintf(stderr, "%s\n", error.what());
+        }
+        fflush(stdout);
+        _exit(result);
+    }
+
+    int status = 0;
+    struct rusage usage = {};
+    if (wait4(child, &status, 0, &usage) != child || !WIFEXITED(status)) {
+        fprintf(stderr, "%s: the scene process crashed\n", path.c_str());
+        return false;
+    }
+    if (WEXITSTATUS(status) == kSceneDone) {
+        printf("%10.1f\n", usage.ru_maxrss / 1024.0);
+        fflush(stdout);
+    }
+    return WEXITSTATUS(status) != kSceneFailed;
+}
+
+int main(int argc, char* argv[]) {
+    Options options = {graphics::IsOffscreenRequested(), true, kDefaultFrames, kDefaultWarmupFrames,
+                       kDefaultFontPath, {}};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--offscreen") == 0) {
+            options.offscreen = true;
+        } else if (strcmp(argv[i], "--no-readback") == 0) {
+            options.readback = false;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.frames = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            options.warmup = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--font") == 0 && i + 1 < argc) {
+            options.font_path = argv[++i];
+        } else {
+            options.scenes.push_back(argv[i]);
+        }
+    }
+
+    if (options.scenes.empty()) {
+        fprintf(stderr, "Usage: %s [--offscreen] [--frames N] [--warmup N] [--font path] [--no-readback] "
+                        "scenes...\n", argv[0]);
+        return 1;
+    }
+
+    printf("%s path, %zu frames after %zu warm-up\n", options.offscreen ? "Offscreen" : "Window",
+           options.frames, options.warmup);
+    PrintHeader();
+
+    int status = 0;
+    for (const std::string& path : options.scenes) {
+        if (!RunSceneProcess(options, path)) {
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -12,9 +12,16 @@ namespace graphics {
     "from standard namespace, dr4. It could be used \n";
 
     class Backend : public cum::DR4BackendPlugin {
+        private:
+            // Taken from the environment when the plugin is loaded
+            bool offscreen_;
+
         public:
+            explicit Backend();
+
             virtual dr4::Window *CreateWindow() override;
-            inline virtual ~Backend() {};
+            // Pooled render targets outlive windows, they go away with the backend
+            virtual ~Backend();
 
             virtual std::string_view GetIdentifier() const {return kBackendName;};
             virtual std::string_view GetName() const {return kBackendName;};
@@ -24,6 +31,9 @@ namespace graphics {
             virtual std::vector<std::string_view> GetConflicts() const {return {};};
 
             virtual void AfterLoad() {};
+
+            // Windows created afterwards render into memory instead of the screen
+            void SetOffscreen(bool offscreen) {offscreen_ = offscreen;};
     };
 
 };
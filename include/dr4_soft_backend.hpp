@@ -0,0 +1,34 @@
+#ifndef DR4_SOFT_BACKEND
+#define DR4_SOFT_BACKEND
+
+#include "cum/ifc/dr4.hpp"
+
+namespace graphics {
+namespace soft {
+
+    std::string const kSoftBackendName = "DenDR4SoftBackend";
+
+    std::string const kSoftDescription =
+    "\t It's a plugin with implementation of methods\n"
+    "from standard namespace, dr4. Everything is drawn \n"
+    "on CPU, it needs neither display nor GPU. \n";
+
+    class Backend : public cum::DR4BackendPlugin {
+        public:
+            virtual dr4::Window *CreateWindow() override;
+            inline virtual ~Backend() {};
+
+            virtual std::string_view GetIdentifier() const {return kSoftBackendName;};
+            virtual std::string_view GetName() const {return kSoftBackendName;};
+            virtual std::string_view GetDescription() const {return kSoftDescription;};
+
+            virtual std::vector<std::string_view> GetDependencies() const {return {};};
+            virtual std::vector<std::string_view> GetConflicts() const {return {};};
+
+            virtual void AfterLoad() {};
+    };
+
+};
+};
+
+#endif // DR4_SOFT_BACKEND
@@ -0,0 +1,80 @@
+#ifndef EVENT_RECORD_HPP
+#define EVENT_RECORD_HPP
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "dr4/event.hpp"
+
+// Event log file: "DR4E", uint16 version, uint16 zero, then one record per event:
+// LEB128 microseconds since the previous record, uint8 dr4::Event::Type and the payload
+// of that type. Numbers are little-endian, floats are IEEE 754 singles.
+namespace graphics {
+
+    const char kEventLogMagic[4] = {'D', 'R', '4', 'E'};
+    const uint16_t kEventLogVersion = 1;
+
+    class EventRecorder {
+        private:
+            FILE* file_;
+            std::string path_;
+            double last_time_;
+            bool started_;
+
+            void WriteBytes(const void* data, size_t size);
+            void WriteVarint(uint64_t value);
+            void WriteFloat(float value);
+
+        public:
+            // Throws std::runtime_error if the file can't be created
+            explicit EventRecorder(const std::string& path);
+
+            EventRecorder(const EventRecorder& other) = delete;
+            EventRecorder& operator=(const EventRecorder& other) = delete;
+
+            ~EventRecorder();
+
+            // time is the capture time in monotonic seconds
+            void Write(const dr4::Event& event, double time);
+            void Flush();
+    };
+
+    struct RecordedEvent {
+        // Seconds since the first record
+        double time;
+        dr4::Event event;
+    };
+
+    // Loads the whole log at once, so replay doesn't touch the disk
+    class EventReplayer {
+        private:
+            std::vector<RecordedEvent> events_;
+            // TEXT_EVENT strings, deque keeps them in place
+            std::deque<std::string> texts_;
+
+            size_t next_;
+            double speed_;
+            double start_time_;
+
+        public:
+            // speed 1 keeps the recorded timing, 2 plays twice as fast, 0 hands out events
+            // as fast as they are polled. Throws std::runtime_error on a bad file.
+            explicit EventReplayer(const std::string& path, double speed, double start_time);
+
+            // The next event if its time (start_time + recorded time / speed) has come,
+            // event_time gets that time (now with speed 0). Text pointers stay valid while
+            // the replayer lives.
+            std::optional<dr4::Event> Next(double now, double& event_time);
+
+            bool IsFinished() const {return next_ == events_.size();};
+            size_t GetEventCount() const {return events_.size();};
+    };
+
+};
+
+#endif // EVENT_RECORD_HPP
@@ -0,0 +1,63 @@
+#ifndef FRAME_PACER_HPP
+#define FRAME_PACER_HPP
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <chrono>
+
+namespace graphics {
+
+    using MonotonicClock = std::chrono::steady_clock;
+
+    // Monotonic time, not related to the wall clock
+    uint64_t MonotonicNanoseconds();
+    double MonotonicSeconds();
+
+    // Sleeps in short slices while the remaining time is bigger than the expected
+    // oversleep of the system timer, then spins to the deadline
+    void PreciseSleep(double seconds);
+    void PreciseSleepUntil(MonotonicClock::time_point deadline);
+
+    // Lateness of wake-ups against frame deadlines, seconds
+    struct FramePacingStats {
+        size_t frames;
+        // Frames that started after their deadline, the schedule is restarted then
+        size_t missed;
+
+        double mean_jitter;
+        double jitter_stddev;
+        double max_jitter;
+    };
+
+    // Keeps a fixed frame period: WaitNextFrame() returns at the next deadline,
+    // deadlines go in steps of period so errors don't accumulate
+    class FramePacer {
+        private:
+            MonotonicClock::duration period_;
+            MonotonicClock::time_point next_deadline_;
+            bool started_;
+
+            FramePacingStats stats_;
+            // Welford's running sum of squared deviations
+            double jitter_m2_;
+
+            void AddJitter(double jitter);
+
+        public:
+            explicit FramePacer(double period = 0);
+
+            void SetPeriod(double period);
+            double GetPeriod() const;
+
+            // Period 0 disables pacing, the call returns at once
+            void WaitNextFrame();
+            // Next WaitNextFrame starts a new schedule
+            void Reset();
+
+            const FramePacingStats& GetStats() const {return stats_;};
+            void ResetStats();
+    };
+
+};
+
+#endif // FRAME_PACER_HPP
@@ -0,0 +1,98 @@
+#ifndef GLYPH_LAYOUT_HPP
+#define GLYPH_LAYOUT_HPP
+
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+namespace graphics {
+
+    // A glyph scaled to the character size, rects are relative to the pen
+    struct LayoutGlyph {
+        float advance;
+        // Textured quad, skipped if the glyph has no texture_rect
+        sf::FloatRect quad;
+        // Drawn part of the quad, text bounds are made of these
+        sf::FloatRect ink;
+        sf::FloatRect texture_rect;
+    };
+
+    // Same pen movement as sf::Text without styles. Appends Triangles for every glyph
+    // and returns the ink bounds, whitespace advances included. kerning(prev, codepoint)
+    // and glyph(codepoint) -> LayoutGlyph come from the font at the character size.
+    template <typename Kerning, typename GlyphLookup>
+    sf::FloatRect LayoutGlyphs(const sf::String& string, unsigned size, float whitespace, float line_spacing,
+                               sf::Color color, Kerning&& kerning, GlyphLookup&& glyph_lookup,
+                               std::vector<sf::Vertex>& vertices) {
+        float x = 0;
+        float y = size;
+        float min_x = size;
+        float min_y = size;
+        float max_x = 0;
+        float max_y = 0;
+        sf::Uint32 prev = 0;
+
+        for (size_t i = 0; i < string.getSize(); i++) {
+            sf::Uint32 codepoint = string[i];
+            if (codepoint == L'\r') {
+                continue;
+            }
+
+            x += kerning(prev, codepoint);
+            prev = codepoint;
+
+            if (codepoint == L' ' || codepoint == L'\t' || codepoint == L'\n') {
+                min_x = std::min(min_x, x);
+                min_y = std::min(min_y, y);
+                if (codepoint == L' ') {
+                    x += whitespace;
+                } else if (codepoint == L'\t') {
+                    x += whitespace * 4;
+                } else {
+                    y += line_spacing;
+                    x = 0;
+                }
+                max_x = std::max(max_x, x);
+                max_y = std::max(max_y, y);
+                continue;
+            }
+
+            LayoutGlyph glyph = glyph_lookup(codepoint);
+            if (glyph.texture_rect.width > 0) {
+                float left = x + glyph.quad.left;
+                float top = y + glyph.quad.top;
+                float right = left + glyph.quad.width;
+                float bottom = top + glyph.quad.height;
+
+                float u1 = glyph.texture_rect.left;
+                float v1 = glyph.texture_rect.top;
+                float u2 = u1 + glyph.texture_rect.width;
+                float v2 = v1 + glyph.texture_rect.height;
+
+                vertices.push_back(sf::Vertex({left,  top   }, color, {u1, v1}));
+                vertices.push_back(sf::Vertex({right, top   }, color, {u2, v1}));
+                vertices.push_back(sf::Vertex({left,  bottom}, color, {u1, v2}));
+                vertices.push_back(sf::Vertex({left,  bottom}, color, {u1, v2}));
+                vertices.push_back(sf::Vertex({right, top   }, color, {u2, v1}));
+                vertices.push_back(sf::Vertex({right, bottom}, color, {u2, v2}));
+            }
+
+            min_x = std::min(min_x, x + glyph.ink.left);
+            max_x = std::max(max_x, x + glyph.ink.left + glyph.ink.width);
+            min_y = std::min(min_y, y + glyph.ink.top);
+            max_y = std::max(max_y, y + glyph.ink.top + glyph.ink.height);
+
+            x += glyph.advance;
+        }
+
+        if (max_x < min_x || max_y < min_y) {
+            return sf::FloatRect();
+        }
+        return sf::FloatRect(min_x, min_y, max_x - min_x, max_y - min_y);
+    }
+
+};
+
+#endif // GLYPH_LAYOUT_HPP
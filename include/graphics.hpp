@@ -2,7 +2,16 @@
 #define GRAPHICS_HPP
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 #include <SFML/Graphics/Vertex.hpp>
 #include <SFML/Graphics.hpp>
@@ -15,12 +24,31 @@
 #include "dr4/event.hpp"
 
 #include "../geometry/include/vector.hpp"
+#include "readback.hpp"
+#include "render_texture_pool.hpp"
+#include "slab_pool.hpp"
+#include "sdf_font.hpp"
+#include "frame_pacer.hpp"
+#include "render_stats.hpp"
+#include "spsc_ring.hpp"
+#include "event_record.hpp"
+#include "input_latency.hpp"
+
+// Xlib connection, only handled by pointer
+struct _XDisplay;
 
 namespace graphics {
 
     class Font : public dr4::Font, public sf::Font {
+        private:
+            // Unique in the process, renewed on every load or mode change, keys cached text layouts
+            size_t generation_;
+
+            bool sdf_enabled_ = false;
+            mutable std::unique_ptr<SdfAtlas> sdf_atlas_;
+
         public:
-            Font() = default;
+            Font();
 
             virtual ~Font();
 
@@ -29,9 +57,25 @@ namespace graphics {
 
             virtual float GetAscent(float fontSize) const override;
             virtual float GetDescent(float fontSize) const override;
+
+            size_t GetGeneration() const {return generation_;};
+
+            // Text with SDF font is drawn at any size from one distance field atlas
+            void SetSdfMode(bool enabled);
+            // False if SDF mode is off or shaders aren't available
+            bool IsSdf() const;
+            SdfAtlas* GetSdfAtlas() const;
+    };
+
+    const size_t kTextLayoutCacheCapacity = 4096;
+
+    // Glyph quads of a string in local coordinates, white
+    struct TextLayout {
+        sf::FloatRect bounds;
+        std::vector<sf::Vertex> vertices;
     };
 
-    class Text : public dr4::Text, public sf::Text {
+    class Text : public dr4::Text, public sf::Text, public SlabAllocated<Text> {
         private:
             const Font* font_;
             dr4::Text::VAlign valign_;
@@ -39,6 +83,18 @@ namespace graphics {
 
             dr4::Vec2f pos_;
 
+            // Layout is recomputed lazily in DrawOn/GetBounds
+            mutable sf::FloatRect bounds_;
+            mutable bool bounds_valid_;
+            mutable bool layout_dirty_;
+            mutable size_t font_generation_;
+
+            // Glyph quads (Triangles) in local coordinates, sampled from the font page
+            // or from the SDF atlas when the font is in SDF mode
+            mutable std::vector<sf::Vertex> vertices_;
+
+            void UpdateLayout() const;
+
         public:
             explicit Text();
 
@@ -68,7 +124,7 @@ namespace graphics {
             void ChangeValign();
     };
 
-    class Line : public dr4::Line, public sf::RectangleShape {
+    class Line : public dr4::Line, public sf::RectangleShape, public SlabAllocated<Line> {
         private:
             bool end_changed_;
             dr4::Vec2f start_;
@@ -94,7 +150,7 @@ namespace graphics {
             virtual dr4::Vec2f GetPos() const override;
     };
 
-    class Circle : public dr4::Circle, public sf::CircleShape {
+    class Circle : public dr4::Circle, public sf::CircleShape, public SlabAllocated<Circle> {
         private:
             dr4::Vec2f center_;
             dr4::Vec2f radius_;
@@ -121,7 +177,8 @@ namespace graphics {
             virtual dr4::Vec2f GetPos() const override;
     };
 
-    class RectangleShape : public dr4::Rectangle, public sf::RectangleShape {
+    class RectangleShape : public dr4::Rectangle, public sf::RectangleShape,
+                           public SlabAllocated<RectangleShape> {
         public:
             explicit RectangleShape();
 
@@ -149,6 +206,17 @@ namespace graphics {
             virtual dr4::Vec2f GetPos() const override;
     };
 
+    // Direct access to RGBA8 pixels of an Image region, valid until UnlockRegion
+    struct PixelRegion {
+        sf::Uint8* pixels;
+        size_t stride;
+
+        unsigned left;
+        unsigned top;
+        unsigned width;
+        unsigned height;
+    };
+
     class Image : public dr4::Image, public sf::Image {
         private:
             float width_;
@@ -156,11 +224,29 @@ namespace graphics {
 
             dr4::Vec2f pos_;
 
+            // GPU copy of the pixels, re-uploaded lazily in DrawOn
+            mutable sf::Texture texture_;
+            mutable bool texture_valid_;
+
+            // Bounding box of pixels changed since the last upload (right/bottom exclusive)
+            mutable unsigned dirty_left_;
+            mutable unsigned dirty_top_;
+            mutable unsigned dirty_right_;
+            mutable unsigned dirty_bottom_;
+
+            mutable std::vector<sf::Uint8> upload_buffer_;
+
+            void MarkDirty(unsigned left, unsigned top, unsigned right, unsigned bottom);
+            void ResetDirty() const;
+            void UploadTexture() const;
+
         public:
             explicit Image(float width, float height);
 
             explicit Image(const sf::Image& other);
 
+            explicit Image(unsigned width, unsigned height, const sf::Uint8* pixels);
+
             virtual ~Image();
 
             virtual void SetPixel(size_t x, size_t y, dr4::Color color) override;
@@ -176,15 +262,55 @@ namespace graphics {
             virtual void SetPos(dr4::Vec2f pos) override;
 
             virtual dr4::Vec2f GetPos() const override;
+
+            // Bulk access: one bounds check per call instead of per pixel
+            PixelRegion LockRegion(unsigned left, unsigned top, unsigned width, unsigned height);
+            void UnlockRegion(const PixelRegion& region);
+
+            void WriteRow(unsigned x, unsigned y, const dr4::Color* colors, size_t count);
+            void ReadRow(unsigned x, unsigned y, dr4::Color* colors, size_t count) const;
+            void FillRegion(unsigned left, unsigned top, unsigned width, unsigned height, dr4::Color color);
     };
 
     const float kMinWidthTexture = 10;
 
-    class Texture : public dr4::Texture, public sf::RenderTexture {
+    const size_t kMaxBatchVertices = 1 << 16;
+    // sf::Sprite is one triangle strip quad
+    const size_t kSpriteVertexCount = 4;
+
+    struct ResolveStats {
+        size_t resolves;
+        size_t skipped;
+    };
+
+    class Texture : public dr4::Texture {
         private:
             dr4::Rect2f main_rect_;
             dr4::Rect2f clip_rect_;
 
+            // Pooled render target, can be bigger than main_rect_.size,
+            // only its top-left corner is used
+            sf::RenderTexture* target_;
+
+            // Triangles in painter's order, already in target coordinates,
+            // all drawn with the same texture and shader
+            sf::VertexArray batch_;
+            const sf::Texture* batch_texture_;
+            const sf::Shader* batch_shader_;
+
+            // Something was drawn since the last display(), the GPU texture is stale
+            bool dirty_;
+            ResolveStats resolve_stats_;
+
+            static ResolveStats total_resolve_stats_;
+
+            void AcquireTarget(dr4::Vec2f size);
+            // Flushes when the batch state changes or there's no room for count vertices
+            void BeginBatch(const sf::Texture* texture, const sf::Shader* shader, size_t count);
+            void SetView(sf::View view);
+            // Throws std::runtime_error if region isn't inside the texture
+            sf::IntRect ReadbackRegion(dr4::Rect2f region) const;
+
         public:
             dr4::Vec2f extent_;
 
@@ -214,24 +340,189 @@ namespace graphics {
             virtual dr4::Rect2f GetClipRect() const override;
 
             virtual dr4::Image* GetImage() const override;
+
+            // Region readback, region is in texture pixels with top-left origin
+            dr4::Image* GetImage(dr4::Rect2f region) const;
+            void ReadPixels(dr4::Rect2f region, sf::Uint8* pixels, size_t stride = 0) const;
+            AsyncReadback* ReadPixelsAsync(dr4::Rect2f region) const;
+
+            // Batches fill and outline of an untextured shape instead of drawing it
+            void AppendShape(const sf::Shape& shape);
+            // Batches triangles, consecutive calls with the same texture share one draw
+            void AppendVertices(const sf::Vertex* vertices, size_t count, const sf::Transform& transform,
+                                const sf::Texture* texture, const sf::Shader* shader = NULL);
+            // Flushes the batch and draws immediately (textured drawables)
+            void DrawDirect(const sf::Drawable& drawable, size_t vertices,
+                            const sf::RenderStates& states = sf::RenderStates::Default);
+            void DrawDirect(const sf::Vertex* vertices, size_t count, sf::PrimitiveType type,
+                            const sf::RenderStates& states = sf::RenderStates::Default);
+            void Flush();
+            // Resolves the render texture only if it has pending draws
+            void Display();
+
+            const sf::Texture& GetSfTexture() const {return target_->getTexture();};
+            sf::IntRect GetTextureRect() const;
+
+            const ResolveStats& GetResolveStats() const {return resolve_stats_;};
+            static const ResolveStats& GetTotalResolveStats() {return total_resolve_stats_;};
+    };
+
+    struct PrimitiveAllocStats {
+        SlabStats lines;
+        SlabStats circles;
+        SlabStats rectangles;
+        SlabStats texts;
+
+        size_t transient;
     };
 
     const size_t kStartWindowWidth = 720;
     const size_t kStartWindowHeight = 480;
 
+    // Non-empty value other than "0" makes windows offscreen
+    const char* const kOffscreenEnvVar = "DR4_BACKEND_OFFSCREEN";
+
+    // Gets every offscreen frame as tightly packed RGBA rows, top row first
+    using FrameSink = std::function<void(const sf::Uint8* pixels, unsigned width, unsigned height)>;
+
+    bool IsOffscreenRequested();
+
+    const size_t kStatsOverlayLength = 256;
+    const unsigned kStatsOverlayFontSize = 14;
+    const float kStatsOverlayPadding = 4;
+
+    // Bit of an event type for RenderWindow::SetEventMask
+    constexpr uint32_t EventMaskOf(dr4::Event::Type type) {return 1u << (unsigned)type;};
+    const uint32_t kAllEventsMask = ~0u;
+
+    // Text of a TEXT_EVENT stays valid for this many following text events
+    const size_t kTextBufferCount = 64;
+
+    // Event with the monotonic time (seconds) it was taken from the system or pushed
+    struct CapturedEvent {
+        dr4::Event event;
+        double time;
+        // TEXT_EVENT string while the event sits in the input ring
+        char text[sizeof(sf::Uint32) + 1];
+    };
+
+    const size_t kInputRingCapacity = 1024;
+    // How often the input thread looks at the system queue when it can't wait on the
+    // X connection (other platforms, events already read by Xlib, full ring)
+    const std::chrono::milliseconds kInputPollSlice(1);
+    // Other threads' Xlib calls may read events off the connection while the input thread
+    // waits on it, so a wait lasts at most this long
+    const int kInputWaitLimitMs = 8;
+
+    // How often WaitEvent checks for events when it can't sleep on the X connection
+    // (replays, other platforms)
+    const std::chrono::milliseconds kWaitEventSlice(2);
+
     class RenderWindow : public dr4::Window, public sf::RenderWindow {
         private:
+            // Defined by micro_bench to time the private event translation
+            friend struct RenderWindowBench;
+
             std::string title_;
 
             float width_;
             float height_;
 
-            char buffer[sizeof(sf::Uint32) + 1];
+            // Offscreen mode: no system window, frames go to render texture and sink,
+            // events come only from PushEvent
+            bool offscreen_;
+            bool offscreen_open_;
+            std::unique_ptr<sf::RenderTexture> offscreen_target_;
+            FrameSink frame_sink_;
+            std::vector<sf::Uint8> frame_buffer_;
+            std::deque<CapturedEvent> injected_events_;
+            // PushEvent and RequestRedraw may come from other threads
+            std::mutex injected_mutex_;
+            std::condition_variable injected_cond_;
+
+            FramePacer frame_pacer_;
+
+            bool redraw_on_demand_;
+            std::atomic<bool> redraw_needed_;
+
+            bool stats_overlay_;
+
+            // TEXT_EVENT strings, each event gets the next buffer
+            char text_buffers_[kTextBufferCount][sizeof(sf::Uint32) + 1];
+            size_t next_text_buffer_;
+
+            // Events whose type isn't in the mask are dropped before translation
+            std::atomic<uint32_t> event_mask_;
+            bool coalesce_events_;
+            // Read ahead while coalescing, returned by the next PollEvent
+            std::optional<sf::Event> pending_event_;
+            dr4::Vec2f last_mouse_pos_;
+            bool has_mouse_pos_;
+
+            // Input thread mode: the thread translates system events into input_ring_,
+            // PollEvent only pops them
+            bool input_thread_enabled_;
+            std::thread input_thread_;
+            std::atomic<bool> input_running_;
+            std::unique_ptr<SpscRing<CapturedEvent>> input_ring_;
+            // SFML handles resizes inside pollEvent, so Draw, Clear, the stats overlay and
+            // GetMousePos take it as well. The buffer swap doesn't.
+            mutable std::mutex window_mutex_;
+            // StopInputThread wakes the thread sleeping on the X connection through it
+            int input_wake_fds_[2];
+
+            // X connection of the window, SFML shares one between its windows and GLX contexts.
+            // NULL if unknown, waits fall back to short sleeps then.
+            _XDisplay* display_;
+            // WaitEvent sleeps on it too, RequestRedraw and the input thread write to it
+            int event_wake_fds_[2];
+
+            double last_event_time_;
+
+            std::unique_ptr<EventRecorder> recorder_;
+            // Kept after the last event, its text pointers have to stay valid
+            std::unique_ptr<EventReplayer> replayer_;
+
+            InputLatencyTracker input_latency_;
 
             const Font* default_font_;
 
             sf::Clipboard clip_board_;
 
+            // Transient primitives live until the end of the current frame
+            std::vector<dr4::Drawable*> frame_arena_;
+
+            void ReleaseFrameArena();
+            void CreateOffscreenTarget();
+            sf::RenderTarget& GetTarget();
+            void DrawStatsOverlay();
+
+            std::optional<dr4::Event> PopInjectedEvent();
+
+            std::optional<dr4::Event> PollSource();
+            std::optional<dr4::Event> PollReplay();
+
+            void InputLoop();
+            void WaitInput(bool ring_full);
+            void SleepUntilEvent(MonotonicClock::time_point deadline);
+            void WakeEventWaiter();
+            void StartInputThread();
+            void StopInputThread();
+            std::optional<dr4::Event> PopCapturedEvent();
+
+            // What PollEvent returns for a system event, also marks the window for redraw
+            dr4::Event TranslateEvent(const sf::Event& sf_event);
+            dr4::Event TranslateEventInto(const sf::Event& sf_event, char* text);
+            char* NextTextBuffer();
+
+            bool NextSystemEvent(sf::Event& sf_event);
+            void CoalesceSystemEvents(const sf::Event& first, dr4::Event& event);
+            bool IsSubscribed(dr4::Event::Type type) const;
+            dr4::Vec2f MapEventPos(int x, int y) const;
+
+            static bool IsCoalescable(dr4::Event::Type type);
+            static void MergeEvent(dr4::Event& event, const dr4::Event& next);
+
         public:
             explicit RenderWindow(size_t width = kStartWindowWidth, size_t height = kStartWindowHeight, const char* window_name = "");
 
@@ -257,7 +548,49 @@ namespace graphics {
             virtual dr4::Rectangle *CreateRectangle() override;
             virtual dr4::Text      *CreateText()      override;
 
+            // Owned by the window and destroyed in the next Display(), don't delete them
+            dr4::Line      *CreateTransientLine();
+            dr4::Circle    *CreateTransientCircle();
+            dr4::Rectangle *CreateTransientRectangle();
+            dr4::Text      *CreateTransientText();
+
+            PrimitiveAllocStats GetAllocStats() const;
+
             virtual std::optional<dr4::Event> PollEvent() override;
+            // Drains pending events into events, returns how many were written
+            size_t PollEvents(dr4::Event* events, size_t capacity);
+
+            // OR of EventMaskOf() for the wanted types, UNKNOWN covers resize, focus and
+            // other untranslated events. Everything is delivered by default.
+            void SetEventMask(uint32_t mask);
+            // Consecutive MOUSE_MOVE (or MOUSE_WHEEL) events come as one: the last position,
+            // rel and delta summed. Off by default.
+            void SetEventCoalescing(bool enabled);
+
+            // Before Open(): a backend thread takes system events as they come and stamps
+            // them, PollEvent reads them from a lock-free ring. Needs a thread-safe Xlib.
+            void SetInputThread(bool enabled);
+            bool IsInputThreadRunning() const {return input_thread_.joinable();};
+            // Monotonic seconds (GetTime() clock) when the last polled event was captured
+            double GetLastEventTime() const {return last_event_time_;};
+
+            // Writes every event PollEvent returns, with capture times, to a binary log
+            void StartRecording(const std::string& path);
+            void StopRecording();
+            // PollEvent returns the logged events instead of live ones (only QUIT passes),
+            // speed 1 keeps the original timing, 0 delivers them as fast as they're polled
+            void StartReplay(const std::string& path, double speed = 1);
+            void StopReplay();
+            bool IsReplaying() const;
+            // Blocks until an event comes, timeout is in seconds, negative waits forever.
+            // Returns nothing on timeout or when a redraw is requested in on-demand mode.
+            std::optional<dr4::Event> WaitEvent(double timeout);
+            // On-demand mode: NeedsRedraw() is true only after an event, a resize or
+            // RequestRedraw() since the last Display(). Otherwise it's always true.
+            void SetRedrawOnDemand(bool on_demand);
+            bool NeedsRedraw() const;
+            // Wakes WaitEvent, may be called from any thread
+            void RequestRedraw();
 
             Coordinates GetMousePos() const;
 
@@ -272,7 +605,9 @@ namespace graphics {
 
             virtual void Clear(dr4::Color color) override;
 
+            // Monotonic seconds with nanosecond resolution
             virtual double GetTime() override;
+            // Fractional seconds, wakes up within tens of microseconds of the deadline
             virtual void Sleep(double time) override;
 
             virtual void StartTextInput() override;
@@ -283,6 +618,40 @@ namespace graphics {
 
             virtual void SetClipboard( const std::string& string ) override;
             virtual std::string GetClipboard() override;
+
+            // Display() waits for the next frame deadline, 0 turns the limit off
+            void SetFrameRateLimit(double frames_per_second);
+            const FramePacingStats& GetFramePacingStats() const {return frame_pacer_.GetStats();};
+
+            // Counters of the last finished frame, shared by all windows of the process
+            const FrameStats& GetFrameStats() const;
+            // Draws the counters in the top-left corner, needs the default font
+            void SetStatsOverlay(bool enabled);
+            // Records Display, resolve, upload and readback timings until WriteTrace
+            // saves them as Chrome trace-event JSON (chrome://tracing, Perfetto)
+            void StartTrace();
+            void WriteTrace(const std::string& path);
+
+            // Time from an event's capture to the Display() after PollEvent returned it.
+            // Display() is counted when the buffer swap is issued, the compositor and
+            // the monitor add their own delay on top. Traces get an async "Input latency"
+            // span per event on a track of their own. Replayed events count from when
+            // they were due.
+            const LatencyHistogram& GetInputLatency() const {return input_latency_.GetHistogram();};
+            void ResetInputLatency();
+            // Keeps per-event samples for WriteLatencySamples
+            void SetLatencySamples(bool enabled);
+            void WriteLatencySamples(const std::string& path) const;
+
+            // Has to be chosen before Open()
+            void SetOffscreen(bool offscreen);
+            bool IsOffscreen() const {return offscreen_;};
+
+            // Without a sink offscreen frames aren't read back at all
+            void SetFrameSink(FrameSink sink);
+            // Queues an event for PollEvent, ahead of system events in every mode.
+            // May be called from any thread.
+            void PushEvent(const dr4::Event& event);
     };
 
 }
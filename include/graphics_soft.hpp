@@ -0,0 +1,396 @@
+#ifndef GRAPHICS_SOFT_HPP
+#define GRAPHICS_SOFT_HPP
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dr4/math/color.hpp"
+#include "dr4/texture.hpp"
+#include "dr4/window.hpp"
+#include "dr4/event.hpp"
+
+#include "soft_raster.hpp"
+#include "tile_renderer.hpp"
+
+struct FT_LibraryRec_;
+struct FT_FaceRec_;
+
+// CPU-only implementation of the dr4 interfaces: no display, no GL context.
+// Pixels, metrics and draw order follow the SFML backend.
+namespace graphics {
+namespace soft {
+
+    // Anti-aliased coverage of one glyph, offsets are relative to the pen on the baseline
+    struct GlyphBitmap {
+        int left;
+        int top;
+        unsigned width;
+        unsigned height;
+        float advance;
+        std::vector<uint8_t> coverage;
+    };
+
+    class Font : public dr4::Font {
+        private:
+            FT_LibraryRec_* library_;
+            FT_FaceRec_* face_;
+
+            // Memory faces read from this buffer, so it lives as long as the face
+            std::vector<uint8_t> buffer_;
+
+            // Bumped on every load, invalidates Text layouts
+            size_t generation_;
+
+            mutable unsigned current_size_;
+            // Key is (character size << 32) | codepoint
+            mutable std::unordered_map<uint64_t, GlyphBitmap> glyphs_;
+
+            void Reset();
+            void SetCurrentSize(unsigned size) const;
+
+        public:
+            explicit Font();
+
+            Font(const Font& other) = delete;
+            Font& operator=(const Font& other) = delete;
+
+            virtual ~Font();
+
+            virtual void LoadFromFile(const std::string& path) override;
+            virtual void LoadFromBuffer(const void* buffer, size_t size) override;
+
+            virtual float GetAscent(float fontSize) const override;
+            virtual float GetDescent(float fontSize) const override;
+
+            size_t GetGeneration() const {return generation_;};
+            bool IsLoaded() const {return face_ != NULL;};
+
+            const GlyphBitmap& GetGlyph(uint32_t codepoint, unsigned size) const;
+            float GetKerning(uint32_t first, uint32_t second, unsigned size) const;
+            float GetLineSpacing(unsigned size) const;
+            float GetUnderlinePosition(unsigned size) const;
+    };
+
+    struct PlacedGlyph {
+        const GlyphBitmap* glyph;
+        float x;
+        float y;
+    };
+
+    class Text : public dr4::Text {
+        private:
+            const Font* font_;
+            dr4::Text::VAlign valign_;
+            std::string text_;
+            dr4::Color color_;
+            unsigned size_;
+
+            dr4::Vec2f pos_;
+
+            // Glyphs relative to the text origin, rebuilt lazily like in the SFML backend
+            mutable std::vector<PlacedGlyph> glyphs_;
+            mutable float bounds_width_;
+            mutable float bounds_height_;
+            mutable bool layout_valid_;
+            mutable size_t font_generation_;
+
+            void UpdateLayout() const;
+            dr4::Vec2f GetOrigin() const;
+
+        public:
+            explicit Text();
+
+            virtual void SetText(const std::string& text) override;
+            virtual void SetColor(dr4::Color color) override;
+            virtual void SetFontSize(float size) override;
+            virtual void SetVAlign(dr4::Text::VAlign align) override;
+            virtual void SetFont(const dr4::Font* font) override;
+
+            virtual dr4::Vec2f GetBounds() const override;
+            virtual const std::string& GetText() const override;
+            virtual dr4::Color GetColor() const override;
+            virtual float GetFontSize() const override;
+            virtual dr4::Text::VAlign GetVAlign() const override;
+            virtual const dr4::Font* GetFont() const override;
+
+            virtual void DrawOn(dr4::Texture& texture) const override;
+
+            virtual void SetPos(dr4::Vec2f pos) override;
+
+            virtual dr4::Vec2f GetPos() const override;
+    };
+
+    class Line : public dr4::Line {
+        private:
+            dr4::Vec2f start_;
+            dr4::Vec2f end_;
+            dr4::Color color_;
+            float thickness_;
+
+        public:
+            explicit Line();
+
+            virtual void SetStart(dr4::Vec2f start) override;
+            virtual void SetEnd(dr4::Vec2f end) override;
+            virtual void SetColor(dr4::Color color) override;
+            virtual void SetThickness(float thickness) override;
+
+            virtual dr4::Vec2f GetStart() const override;
+            virtual dr4::Vec2f GetEnd() const override;
+            virtual dr4::Color GetColor() const override;
+            virtual float GetThickness() const override;
+
+            virtual void DrawOn(dr4::Texture& texture) const override;
+
+            virtual void SetPos(dr4::Vec2f pos) override;
+
+            virtual dr4::Vec2f GetPos() const override;
+    };
+
+    class Circle : public dr4::Circle {
+        private:
+            dr4::Vec2f center_;
+            dr4::Vec2f radius_;
+            dr4::Color fill_color_;
+            dr4::Color border_color_;
+            float border_thickness_;
+
+        public:
+            explicit Circle();
+
+            virtual void SetCenter(dr4::Vec2f center) override;
+            virtual void SetRadius(dr4::Vec2f radius) override;
+            virtual void SetFillColor(dr4::Color color) override;
+            virtual void SetBorderColor(dr4::Color color) override;
+            virtual void SetBorderThickness(float thickness) override;
+
+            virtual dr4::Vec2f GetCenter() const override;
+            virtual dr4::Vec2f GetRadius() const override;
+            virtual dr4::Color GetFillColor() const override;
+            virtual dr4::Color GetBorderColor() const override;
+            virtual float GetBorderThickness() const override;
+
+            virtual void DrawOn(dr4::Texture& texture) const override;
+
+            virtual void SetPos(dr4::Vec2f pos) override;
+
+            virtual dr4::Vec2f GetPos() const override;
+    };
+
+    class RectangleShape : public dr4::Rectangle {
+        private:
+            dr4::Vec2f pos_;
+            dr4::Vec2f size_;
+            dr4::Color fill_color_;
+            dr4::Color border_color_;
+            float border_thickness_;
+
+        public:
+            explicit RectangleShape();
+
+            virtual void SetSize(dr4::Vec2f size) override;
+            virtual void SetFillColor(dr4::Color color) override;
+            virtual void SetBorderThickness(float thickness) override;
+            virtual void SetBorderColor(dr4::Color color) override;
+
+            virtual dr4::Vec2f GetSize() const override;
+            virtual dr4::Color GetFillColor() const override;
+            virtual float GetBorderThickness() const override;
+            virtual dr4::Color GetBorderColor() const override;
+
+            virtual void DrawOn(dr4::Texture& texture) const override;
+
+            virtual void SetPos(dr4::Vec2f pos) override;
+
+            virtual dr4::Vec2f GetPos() const override;
+    };
+
+    // Image and Texture pixels are copy-on-write: a recorded blit keeps a reference
+    // to the source pixels instead of a copy, the next write to the source clones them
+    using SharedSurface = std::shared_ptr<const Surface>;
+
+    class Image : public dr4::Image {
+        private:
+            std::shared_ptr<Surface> surface_;
+
+            Surface& GetWritableSurface();
+
+            float width_;
+            float height_;
+
+            dr4::Vec2f pos_;
+
+        public:
+            explicit Image(float width, float height);
+
+            explicit Image(const Surface& surface);
+
+            virtual ~Image();
+
+            virtual void SetPixel(size_t x, size_t y, dr4::Color color) override;
+            virtual dr4::Color GetPixel(size_t x, size_t y) const override;
+
+            virtual void SetSize(dr4::Vec2f size) override;
+            virtual dr4::Vec2f GetSize() const override;
+            virtual float GetWidth() const override;
+            virtual float GetHeight() const override;
+
+            virtual void DrawOn(dr4::Texture& texture) const override;
+
+            virtual void SetPos(dr4::Vec2f pos) override;
+
+            virtual dr4::Vec2f GetPos() const override;
+
+            const Surface& GetSurface() const {return *surface_;};
+    };
+
+    const float kMinWidthTexture = 10;
+
+    class Texture : public dr4::Texture {
+        private:
+            dr4::Rect2f main_rect_;
+            dr4::Rect2f clip_rect_;
+
+            std::shared_ptr<Surface> surface_;
+            // Clip rect in surface pixels, always inside the surface
+            ClipRect clip_;
+
+            // Set in tiled mode: draws are recorded and rasterized in parallel on Flush
+            std::unique_ptr<TileRenderer> tiles_;
+
+            void UpdateClip();
+            Surface& GetWritableSurface();
+
+        public:
+            dr4::Vec2f extent_;
+
+            explicit Texture(float width, float height);
+            explicit Texture(const Texture& other);
+
+            virtual ~Texture();
+
+            virtual void SetSize(dr4::Vec2f size) override;
+            virtual dr4::Vec2f GetSize() const override;
+            virtual float GetWidth() const override;
+            virtual float GetHeight() const override;
+
+            virtual void SetZero(dr4::Vec2f pos) override;
+            virtual dr4::Vec2f GetZero() const override;
+
+            virtual void Clear(dr4::Color color) override;
+
+            virtual void DrawOn(dr4::Texture& texture) const override;
+
+            virtual void SetPos(dr4::Vec2f pos) override;
+
+            virtual dr4::Vec2f GetPos() const override;
+
+            virtual void SetClipRect(dr4::Rect2f rect) override;
+            virtual void RemoveClipRect() override;
+            virtual dr4::Rect2f GetClipRect() const override;
+
+            virtual dr4::Image* GetImage() const override;
+
+            // Drawing entry points for the primitives, coordinates are relative to the zero point
+            void FillRect(float left, float top, float right, float bottom, dr4::Color color);
+            void FillPath(const Contour* contours, size_t count, dr4::Color color);
+            void BlitMask(const GlyphBitmap& glyph, float x, float y, dr4::Color color);
+            void BlitSurface(const SharedSurface& source, float x, float y);
+
+            void SetTiled(bool enabled);
+            bool IsTiled() const {return tiles_ != NULL;};
+            // Rasterizes recorded draws, called implicitly whenever the pixels are read
+            void Flush();
+
+            const Surface& GetSurface() const;
+            SharedSurface GetSnapshot() const;
+    };
+
+    const size_t kStartWindowWidth = 720;
+    const size_t kStartWindowHeight = 480;
+
+    // Called from Display() with the finished frame
+    using FrameSink = std::function<void(const Surface& frame)>;
+
+    class RenderWindow : public dr4::Window {
+        private:
+            std::string title_;
+
+            float width_;
+            float height_;
+
+            bool is_open_;
+            bool tiled_rendering_;
+            Surface frame_;
+            FrameSink frame_sink_;
+
+            // There's no system event source, events are injected with PushEvent
+            std::deque<dr4::Event> events_;
+
+            const Font* default_font_;
+
+            std::string clip_board_;
+
+        public:
+            explicit RenderWindow(size_t width = kStartWindowWidth, size_t height = kStartWindowHeight, const char* window_name = "");
+
+            ~RenderWindow();
+
+            virtual dr4::Vec2f GetSize() const override;
+            virtual void SetSize(dr4::Vec2f size) override;
+
+            virtual void SetTitle(const std::string &title) override;
+            virtual const std::string &GetTitle() const override;
+
+            virtual dr4::Texture   *CreateTexture()   override;
+            virtual dr4::Image     *CreateImage()     override;
+            virtual dr4::Font      *CreateFont()      override;
+            virtual dr4::Line      *CreateLine()      override;
+            virtual dr4::Circle    *CreateCircle()    override;
+            virtual dr4::Rectangle *CreateRectangle() override;
+            virtual dr4::Text      *CreateText()      override;
+
+            virtual std::optional<dr4::Event> PollEvent() override;
+            void PushEvent(const dr4::Event& event);
+
+            virtual void Draw(const dr4::Texture &texture) override;
+
+            virtual void Display() override;
+
+            virtual bool IsOpen() const override;
+
+            virtual void Open() override;
+            virtual void Close() override;
+
+            virtual void Clear(dr4::Color color) override;
+
+            virtual double GetTime() override;
+            virtual void Sleep(double time) override;
+
+            virtual void StartTextInput() override;
+            virtual void StopTextInput() override;
+
+            virtual void SetDefaultFont( const dr4::Font* font ) override;
+            virtual const dr4::Font* GetDefaultFont() override;
+
+            virtual void SetClipboard( const std::string& string ) override;
+            virtual std::string GetClipboard() override;
+
+            // Textures created afterwards record draws and rasterize them by tiles
+            // on all cores, pays off for big textures with many primitives
+            void SetTiledRendering(bool enabled);
+
+            void SetFrameSink(FrameSink sink);
+            const Surface& GetFrame() const {return frame_;};
+    };
+
+};
+};
+
+#endif // GRAPHICS_SOFT_HPP
@@ -0,0 +1,94 @@
+#ifndef INPUT_LATENCY_HPP
+#define INPUT_LATENCY_HPP
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "dr4/event.hpp"
+
+namespace graphics {
+
+    // Buckets grow by a quarter of an octave from kLatencyHistogramMin, the last one
+    // (about 2.4 s) takes everything above
+    const size_t kLatencyBuckets = 64;
+    const double kLatencyHistogramMin = 50e-6;
+    const size_t kLatencyBucketsPerOctave = 4;
+
+    // Events polled but not displayed yet; a window that never calls Display() stops
+    // collecting here instead of growing
+    const size_t kMaxPendingLatencyEvents = 4096;
+    const size_t kMaxLatencySamples = 1 << 20;
+
+    // Log-scale histogram of latencies in seconds, percentiles are accurate to a bucket
+    class LatencyHistogram {
+        private:
+            uint64_t buckets_[kLatencyBuckets];
+            size_t count_;
+            double sum_;
+            double min_;
+            double max_;
+
+        public:
+            explicit LatencyHistogram();
+
+            void Add(double latency);
+            void Reset();
+
+            size_t GetCount() const {return count_;};
+            double GetMean() const {return (count_ != 0) ? sum_ / count_ : 0;};
+            double GetMin() const {return min_;};
+            double GetMax() const {return max_;};
+            // Upper bound of the bucket holding the p-th (0..1) latency, clamped to GetMax()
+            double GetPercentile(double p) const;
+
+            static size_t GetBucketIndex(double latency);
+            // Latencies of bucket i are below this bound and not below the bound of i - 1
+            static double GetBucketUpperBound(size_t i);
+            uint64_t GetBucket(size_t i) const {return buckets_[i];};
+    };
+
+    // One event from capture to the Display() that presented its result
+    struct LatencySample {
+        dr4::Event::Type type;
+        // Monotonic seconds, GetTime() clock
+        double capture_time;
+        double display_time;
+    };
+
+    // Input-to-photon latency: every event handed to the application is pending until
+    // the next Display(), then its capture-to-present time goes into the histogram
+    class InputLatencyTracker {
+        private:
+            struct PendingEvent {
+                dr4::Event::Type type;
+                double capture_time;
+            };
+
+            std::vector<PendingEvent> pending_;
+            LatencyHistogram histogram_;
+
+            bool keep_samples_;
+            std::vector<LatencySample> samples_;
+
+        public:
+            explicit InputLatencyTracker();
+
+            void AddEvent(dr4::Event::Type type, double capture_time);
+            // display_time is when the frame was handed to the system (buffer swap)
+            void OnDisplay(double display_time);
+
+            const LatencyHistogram& GetHistogram() const {return histogram_;};
+            void Reset();
+
+            // Per-event samples, up to kMaxLatencySamples
+            void SetKeepSamples(bool keep);
+            const std::vector<LatencySample>& GetSamples() const {return samples_;};
+            // CSV: event type, capture time, display time, latency in milliseconds
+            void WriteSamples(const std::string& path) const;
+    };
+
+};
+
+#endif // INPUT_LATENCY_HPP
@@ -0,0 +1,20 @@
+#ifndef PIXELS_HPP
+#define PIXELS_HPP
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "dr4/math/color.hpp"
+
+namespace graphics {
+
+    // All pixel buffers are RGBA8, one byte per channel in this order
+
+    void ColorsToRgba8(const dr4::Color* colors, uint8_t* pixels, size_t count);
+    void Rgba8ToColors(const uint8_t* pixels, dr4::Color* colors, size_t count);
+
+    void FillRgba8(uint8_t* pixels, dr4::Color color, size_t count);
+
+};
+
+#endif // PIXELS_HPP
@@ -0,0 +1,50 @@
+#ifndef READBACK_HPP
+#define READBACK_HPP
+
+#include <stdlib.h>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+struct __GLsync;
+
+namespace graphics {
+
+    // Reads region of render texture into RGBA rows (top row first).
+    // size is the used top-left part of target (pooled targets can be bigger),
+    // region has to lie inside it. stride == 0 means tightly packed rows.
+    void ReadPixels(sf::RenderTexture& target, sf::Vector2u size, sf::IntRect region,
+                    sf::Uint8* pixels, size_t stride = 0);
+
+    // Region readback into pixel pack buffer guarded by a fence, so the render loop
+    // doesn't wait for the GPU. Poll IsReady() once per frame (usually ready after
+    // one or two frames) and use it only on the rendering thread. Drivers without
+    // pixel buffers or fences get a synchronous read, ready at once.
+    class AsyncReadback {
+        private:
+            unsigned int buffer_;
+            __GLsync* fence_;
+            sf::IntRect region_;
+            bool ready_;
+            // Synchronous fallback
+            std::vector<sf::Uint8> pixels_;
+
+        public:
+            explicit AsyncReadback(sf::RenderTexture& target, sf::Vector2u size, sf::IntRect region);
+
+            AsyncReadback(const AsyncReadback& other) = delete;
+            AsyncReadback& operator=(const AsyncReadback& other) = delete;
+
+            ~AsyncReadback();
+
+            sf::IntRect GetRegion() const {return region_;};
+
+            bool IsReady();
+
+            // Returns false if the GPU hasn't finished yet, pixels are untouched then
+            bool Fetch(sf::Uint8* pixels, size_t stride = 0);
+    };
+
+};
+
+#endif // READBACK_HPP
@@ -0,0 +1,102 @@
+#ifndef RENDER_STATS_HPP
+#define RENDER_STATS_HPP
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace graphics {
+
+    // What one frame cost, counted between two RenderWindow::Display() calls
+    struct FrameStats {
+        size_t draw_calls;
+        size_t vertices;
+        // Image pixels sent to the GPU
+        size_t uploads;
+        size_t upload_bytes;
+        // Render texture resolves (Texture::Display with pending draws)
+        size_t resolves;
+        // Pixels read back from the GPU, offscreen frame sink included
+        size_t readbacks;
+        size_t readback_bytes;
+
+        // Seconds spent in Display() without the frame pacer wait
+        double display_time;
+        // Seconds since the previous Display()
+        double frame_time;
+    };
+
+    // Chrome trace-event "complete" event on the rendering thread's track, or an async
+    // span on a track of its own if it can overlap others. Times are monotonic nanoseconds.
+    struct TraceEvent {
+        const char* name;
+        uint64_t start;
+        uint64_t duration;
+        bool async;
+    };
+
+    // Stops recording instead of eating memory if the trace is never written
+    const size_t kMaxTraceEvents = 1 << 20;
+
+    // Counters shared by every texture and window of the process: textures don't know
+    // which window they end up in. Rendering happens on one thread, so no locking.
+    class RenderStats {
+        private:
+            FrameStats current_;
+            FrameStats last_;
+            uint64_t frame_start_;
+
+            bool tracing_;
+            std::vector<TraceEvent> trace_;
+            // Per-frame counter snapshots, written as "C" events
+            std::vector<std::pair<uint64_t, FrameStats>> trace_frames_;
+
+            explicit RenderStats();
+
+        public:
+            static RenderStats& Get();
+
+            void CountDrawCall(size_t vertices) {current_.draw_calls++; current_.vertices += vertices;};
+            void CountUpload(size_t bytes) {current_.uploads++; current_.upload_bytes += bytes;};
+            void CountResolve() {current_.resolves++;};
+            void CountReadback(size_t bytes) {current_.readbacks++; current_.readback_bytes += bytes;};
+
+            // Closes the current frame, display_time is in seconds
+            void EndFrame(double display_time);
+
+            const FrameStats& GetLastFrame() const {return last_;};
+            const FrameStats& GetCurrentFrame() const {return current_;};
+
+            // Recording starts empty, old events are dropped
+            void StartTrace();
+            void StopTrace();
+            bool IsTracing() const {return tracing_;};
+            void AddTraceEvent(const char* name, uint64_t start, uint64_t end);
+            // Spans that don't nest with the frame ones (input latency), written as "b"/"e" pairs
+            void AddAsyncTraceEvent(const char* name, uint64_t start, uint64_t end);
+
+            // JSON for chrome://tracing and Perfetto
+            void WriteTrace(const std::string& path) const;
+    };
+
+    // Adds a trace event covering its lifetime, costs one branch when tracing is off.
+    // name must be a string literal.
+    class TraceScope {
+        private:
+            const char* name_;
+            uint64_t start_;
+
+        public:
+            explicit TraceScope(const char* name);
+
+            TraceScope(const TraceScope& other) = delete;
+            TraceScope& operator=(const TraceScope& other) = delete;
+
+            ~TraceScope();
+    };
+
+};
+
+#endif // RENDER_STATS_HPP
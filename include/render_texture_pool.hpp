@@ -0,0 +1,58 @@
+#ifndef RENDER_TEXTURE_POOL_HPP
+#define RENDER_TEXTURE_POOL_HPP
+
+#include <stdlib.h>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+namespace graphics {
+
+    const unsigned kPoolMinBucket = 16;
+    const unsigned kPoolPowerOfTwoLimit = 256;
+    const unsigned kPoolLargeBucketStep = 256;
+
+    const size_t kPoolMaxFreeTargets = 32;
+
+    struct RenderTexturePoolStats {
+        size_t created;
+        size_t reused;
+        size_t released;
+        size_t destroyed;
+        size_t free;
+    };
+
+    // Recycles render textures between graphics::Texture objects. Sizes are rounded up
+    // to buckets, so a texture gets a target at least as big as asked and draws into
+    // its top-left corner through the view's viewport.
+    class RenderTexturePool {
+        private:
+            std::map<std::pair<unsigned, unsigned>, std::vector<sf::RenderTexture*>> free_;
+            RenderTexturePoolStats stats_;
+
+            explicit RenderTexturePool();
+
+        public:
+            RenderTexturePool(const RenderTexturePool& other) = delete;
+            RenderTexturePool& operator=(const RenderTexturePool& other) = delete;
+
+            ~RenderTexturePool();
+
+            static RenderTexturePool& Get();
+
+            static unsigned BucketSize(unsigned size);
+
+            sf::RenderTexture* Acquire(unsigned width, unsigned height);
+            void Release(sf::RenderTexture* target);
+
+            // Destroys all free targets, must be called while GL is still alive
+            void Clear();
+
+            const RenderTexturePoolStats& GetStats() const {return stats_;};
+    };
+
+};
+
+#endif // RENDER_TEXTURE_POOL_HPP
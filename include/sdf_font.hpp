@@ -0,0 +1,66 @@
+#ifndef SDF_FONT_HPP
+#define SDF_FONT_HPP
+
+#include <stdlib.h>
+#include <unordered_map>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+namespace graphics {
+
+    // Glyphs are rasterized by SFML once at this size and converted to distance fields
+    const unsigned kSdfBaseSize = 48;
+    // Distance range encoded in the field, pixels at base size
+    const unsigned kSdfSpread = 6;
+
+    const unsigned kSdfAtlasWidth = 1024;
+    const unsigned kSdfAtlasStartHeight = 256;
+
+    struct SdfGlyph {
+        float advance;
+        // Quad around the glyph including the spread, base size, relative to the pen
+        sf::FloatRect bounds;
+        // Ink part of the quad, used for text bounds
+        sf::FloatRect ink_bounds;
+        sf::IntRect texture_rect;
+    };
+
+    // Distance field atlas for one font: memory doesn't depend on how many
+    // character sizes are used, Text scales quads and the shader keeps edges sharp
+    class SdfAtlas {
+        private:
+            const sf::Font& font_;
+
+            sf::Image image_;
+            sf::Texture texture_;
+
+            std::unordered_map<sf::Uint32, SdfGlyph> glyphs_;
+
+            unsigned shelf_x_;
+            unsigned shelf_y_;
+            unsigned shelf_height_;
+
+            void LoadGlyphs(const std::vector<sf::Uint32>& codepoints);
+            sf::IntRect AllocateRect(unsigned width, unsigned height);
+            void GrowAtlas();
+
+        public:
+            explicit SdfAtlas(const sf::Font& font);
+
+            SdfAtlas(const SdfAtlas& other) = delete;
+            SdfAtlas& operator=(const SdfAtlas& other) = delete;
+
+            const sf::Texture& GetTexture() const {return texture_;};
+
+            // NULL when shaders aren't supported, SDF text can't be drawn then
+            static const sf::Shader* GetShader();
+
+            // Appends Triangles for the string scaled to character size, returns ink bounds
+            sf::FloatRect BuildVertices(const sf::String& string, unsigned size, sf::Color color,
+                                        std::vector<sf::Vertex>& vertices);
+    };
+
+};
+
+#endif // SDF_FONT_HPP
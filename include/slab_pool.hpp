@@ -0,0 +1,121 @@
+#ifndef SLAB_POOL_HPP
+#define SLAB_POOL_HPP
+
+#include <stdlib.h>
+#include <new>
+#include <vector>
+
+namespace graphics {
+
+    const size_t kSlabObjectCount = 256;
+
+    struct SlabStats {
+        size_t allocations;
+        size_t deallocations;
+        size_t live;
+        size_t peak_live;
+        size_t slabs;
+    };
+
+    // Fixed-size blocks carved from slabs of kSlabObjectCount objects with an intrusive
+    // free list. Slabs are never returned to the system. Not thread-safe, meant for
+    // objects created on the rendering thread.
+    template <size_t BlockSize, size_t BlockAlign>
+    class SlabPool {
+        private:
+            union Block {
+                Block* next;
+                alignas(BlockAlign) unsigned char storage[BlockSize];
+            };
+
+            std::vector<Block*> slabs_;
+            Block* free_list_;
+            SlabStats stats_;
+
+            void Grow() {
+                Block* slab = static_cast<Block*>(::operator new(sizeof(Block) * kSlabObjectCount));
+                for (size_t i = 0; i < kSlabObjectCount; i++) {
+                    slab[i].next = (i + 1 < kSlabObjectCount) ? &slab[i + 1] : free_list_;
+                }
+                free_list_ = slab;
+                slabs_.push_back(slab);
+                stats_.slabs++;
+            };
+
+        public:
+            explicit SlabPool()
+                :slabs_(), free_list_(NULL), stats_({0, 0, 0, 0, 0}) {};
+
+            SlabPool(const SlabPool& other) = delete;
+            SlabPool& operator=(const SlabPool& other) = delete;
+
+            ~SlabPool() {
+                for (Block* slab : slabs_) {
+                    ::operator delete(slab);
+                }
+            };
+
+            void* Allocate() {
+                if (free_list_ == NULL) {
+                    Grow();
+                }
+                Block* block = free_list_;
+                free_list_ = block->next;
+
+                stats_.allocations++;
+                stats_.live++;
+                if (stats_.live > stats_.peak_live) {
+                    stats_.peak_live = stats_.live;
+                }
+                return block->storage;
+            };
+
+            void Deallocate(void* ptr) {
+                if (ptr == NULL) {
+                    return;
+                }
+                Block* block = reinterpret_cast<Block*>(ptr);
+                block->next = free_list_;
+                free_list_ = block;
+
+                stats_.deallocations++;
+                stats_.live--;
+            };
+
+            const SlabStats& GetStats() const {return stats_;};
+    };
+
+    // Gives class T pooled operator new/delete, so "new T" and "delete ptr" from
+    // plugin users go through the slab pool. Derived classes of bigger size fall
+    // back to the global heap.
+    template <typename T>
+    class SlabAllocated {
+        private:
+            // Never destroyed: objects may be deleted during static destruction
+            static auto& GetPool() {
+                static auto* pool = new SlabPool<sizeof(T), alignof(T)>();
+                return *pool;
+            };
+
+        public:
+            static void* operator new(size_t size) {
+                if (size != sizeof(T)) {
+                    return ::operator new(size);
+                }
+                return GetPool().Allocate();
+            };
+
+            static void operator delete(void* ptr, size_t size) {
+                if (size != sizeof(T)) {
+                    ::operator delete(ptr);
+                    return;
+                }
+                GetPool().Deallocate(ptr);
+            };
+
+            static const SlabStats& GetSlabStats() {return GetPool().GetStats();};
+    };
+
+};
+
+#endif // SLAB_POOL_HPP
@@ -0,0 +1,80 @@
+#ifndef SOFT_RASTER_HPP
+#define SOFT_RASTER_HPP
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+
+#include "dr4/math/color.hpp"
+
+namespace graphics {
+namespace soft {
+
+    // RGBA8 pixels, bytes in r, g, b, a order (same layout as sf::Image)
+    struct Surface {
+        unsigned width;
+        unsigned height;
+        std::vector<uint32_t> pixels;
+
+        explicit Surface(unsigned width = 0, unsigned height = 0)
+            :width(width), height(height), pixels((size_t)width * height, 0) {};
+
+        void Resize(unsigned new_width, unsigned new_height) {
+            width = new_width;
+            height = new_height;
+            pixels.assign((size_t)width * height, 0);
+        };
+
+        uint32_t* Row(unsigned y) {return pixels.data() + (size_t)y * width;};
+        const uint32_t* Row(unsigned y) const {return pixels.data() + (size_t)y * width;};
+    };
+
+    // Integer pixel rectangle, right and bottom are exclusive
+    struct ClipRect {
+        int left;
+        int top;
+        int right;
+        int bottom;
+
+        bool IsEmpty() const {return left >= right || top >= bottom;};
+    };
+
+    ClipRect IntersectClip(const ClipRect& first, const ClipRect& second);
+    ClipRect SurfaceClip(const Surface& surface);
+
+    struct PathPoint {
+        float x;
+        float y;
+    };
+
+    // Closed polygon, several contours of one path are filled with non-zero winding
+    struct Contour {
+        std::vector<PathPoint> points;
+    };
+
+    uint32_t PackColor(dr4::Color color);
+    dr4::Color UnpackColor(uint32_t pixel);
+
+    // Same blending as SFML's BlendAlpha: rgb = src * a + dst * (1 - a), alpha = a + dst_a * (1 - a)
+    void BlendSpan(uint32_t* pixels, size_t count, dr4::Color color);
+    void BlendPixel(uint32_t* pixel, dr4::Color color, unsigned coverage);
+
+    void FillClip(Surface& surface, const ClipRect& rect, dr4::Color color);
+    // Axis-aligned rectangle with anti-aliased fractional edges
+    void FillRect(Surface& surface, float left, float top, float right, float bottom,
+                  dr4::Color color, const ClipRect& clip);
+    // Any path translated by offset, exact area coverage for anti-aliasing,
+    // interior runs go to BlendSpan
+    void FillPath(Surface& surface, const Contour* contours, size_t count, PathPoint offset,
+                  dr4::Color color, const ClipRect& clip);
+
+    // Source-over copy of src placed with its top-left corner at (x, y)
+    void BlitSurface(Surface& dst, const Surface& src, int x, int y, const ClipRect& clip);
+    // 8-bit coverage mask (glyph bitmap) tinted with color
+    void BlitMask(Surface& dst, const uint8_t* mask, unsigned width, unsigned height, size_t pitch,
+                  int x, int y, dr4::Color color, const ClipRect& clip);
+
+};
+};
+
+#endif // SOFT_RASTER_HPP
@@ -0,0 +1,76 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <stdlib.h>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+namespace graphics {
+
+    const size_t kCacheLineSize = 64;
+
+    // Lock-free ring for exactly one producer thread and one consumer thread.
+    // Each side caches the other's index and rereads it only when the ring looks
+    // full (or empty), so the cache line ping-pong happens at most once per lap.
+    template <typename T>
+    class SpscRing {
+        private:
+            std::vector<T> items_;
+            size_t mask_;
+
+            alignas(kCacheLineSize) std::atomic<size_t> head_;
+            size_t cached_tail_;
+
+            alignas(kCacheLineSize) std::atomic<size_t> tail_;
+            size_t cached_head_;
+
+        public:
+            // capacity has to be a power of two
+            explicit SpscRing(size_t capacity)
+                :items_(capacity), mask_(capacity - 1), head_(0), cached_tail_(0), tail_(0), cached_head_(0) {
+                if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+                    throw std::runtime_error("Ring capacity has to be a power of two");
+                }
+            };
+
+            SpscRing(const SpscRing& other) = delete;
+            SpscRing& operator=(const SpscRing& other) = delete;
+
+            size_t GetCapacity() const {return items_.size();};
+
+            // Producer side, false if the ring is full
+            bool TryPush(const T& item) {
+                size_t tail = tail_.load(std::memory_order_relaxed);
+                if (tail - cached_head_ == items_.size()) {
+                    cached_head_ = head_.load(std::memory_order_acquire);
+                    if (tail - cached_head_ == items_.size()) {
+                        return false;
+                    }
+                }
+                items_[tail & mask_] = item;
+                tail_.store(tail + 1, std::memory_order_release);
+                return true;
+            };
+
+            // Consumer side: the oldest item or NULL, valid until Pop()
+            const T* Front() {
+                size_t head = head_.load(std::memory_order_relaxed);
+                if (head == cached_tail_) {
+                    cached_tail_ = tail_.load(std::memory_order_acquire);
+                    if (head == cached_tail_) {
+                        return NULL;
+                    }
+                }
+                return &items_[head & mask_];
+            };
+
+            // Consumer side, only after Front() returned an item
+            void Pop() {
+                head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            };
+    };
+
+};
+
+#endif // SPSC_RING_HPP
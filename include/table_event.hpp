@@ -1,7 +1,8 @@
 #ifndef TABLE_EVENT_HPP
 #define TABLE_EVENT_HPP
 
-#include <map>
+#include <stddef.h>
+#include <array>
 
 #include <SFML/Window/Event.hpp>
 #include <SFML/Window/Keyboard.hpp>
@@ -14,7 +15,27 @@
 
 namespace graphics {
 
-    const std::map<sf::Event::EventType, dr4::Event::Type> kEventTypeTransformMap{
+    template <typename Key, typename Value>
+    struct TableEntry {
+        Key key;
+        Value value;
+    };
+
+    // Dense array indexed by the SFML enum value, built at compile time from the entry list.
+    // Keys missing from the list map to missing.
+    template <size_t kSize, typename Key, typename Value, size_t kCount>
+    constexpr std::array<Value, kSize> MakeDenseTable(const TableEntry<Key, Value> (&entries)[kCount], Value missing) {
+        std::array<Value, kSize> table = {};
+        for (size_t i = 0; i < kSize; i++) {
+            table[i] = missing;
+        }
+        for (size_t i = 0; i < kCount; i++) {
+            table[(size_t)entries[i].key] = entries[i].value;
+        }
+        return table;
+    }
+
+    inline constexpr TableEntry<sf::Event::EventType, dr4::Event::Type> kEventTypeEntries[] = {
         {sf::Event::EventType::Closed,              dr4::Event::Type::QUIT          },
         {sf::Event::EventType::KeyPressed,          dr4::Event::Type::KEY_DOWN      },
         {sf::Event::EventType::KeyReleased,         dr4::Event::Type::KEY_UP        },
@@ -25,13 +46,13 @@ namespace graphics {
         {sf::Event::EventType::TextEntered,         dr4::Event::Type::TEXT_EVENT    },
     };
 
-    const std::map<sf::Mouse::Button, dr4::MouseButtonType> kMouseButtonTransformMap{
+    inline constexpr TableEntry<sf::Mouse::Button, dr4::MouseButtonType> kMouseButtonEntries[] = {
         {sf::Mouse::Button::Left,   dr4::MouseButtonType::LEFT  },
         {sf::Mouse::Button::Right,  dr4::MouseButtonType::RIGHT },
         {sf::Mouse::Button::Middle, dr4::MouseButtonType::MIDDLE},
     };
 
-    const std::map<sf::Keyboard::Scan::Scancode, dr4::KeyCode>  kKeyCodeTransformMap{
+    inline constexpr TableEntry<sf::Keyboard::Scan::Scancode, dr4::KeyCode> kKeyCodeEntries[] = {
         {sf::Keyboard::Scan::Scancode::A, dr4::KeyCode::KEYCODE_A},
         {sf::Keyboard::Scan::Scancode::B, dr4::KeyCode::KEYCODE_B},
         {sf::Keyboard::Scan::Scancode::C, dr4::KeyCode::KEYCODE_C},
@@ -142,6 +163,32 @@ namespace graphics {
         {sf::Keyboard::Scan::Scancode::Pause, dr4::KeyCode::KEYCODE_PAUSE},
     };
 
+    inline constexpr std::array<dr4::Event::Type, sf::Event::Count> kEventTypeTable =
+        MakeDenseTable<sf::Event::Count>(kEventTypeEntries, dr4::Event::Type::UNKNOWN);
+
+    inline constexpr std::array<dr4::MouseButtonType, sf::Mouse::ButtonCount> kMouseButtonTable =
+        MakeDenseTable<sf::Mouse::ButtonCount>(kMouseButtonEntries, dr4::MouseButtonType::UNKNOWN);
+
+    inline constexpr std::array<dr4::KeyCode, sf::Keyboard::Scan::ScancodeCount> kKeyCodeTable =
+        MakeDenseTable<sf::Keyboard::Scan::ScancodeCount>(kKeyCodeEntries, dr4::KeyCode::KEYCODE_UNKNOWN);
+
+    static_assert(kKeyCodeTable[sf::Keyboard::Scan::Scancode::Pause] == dr4::KeyCode::KEYCODE_PAUSE,
+                  "Key code table is built at compile time");
+
+    // Out of range values (sf::Keyboard::Scan::Unknown is -1) are unknown too
+    inline dr4::Event::Type TranslateEventType(sf::Event::EventType type) {
+        return ((size_t)type < kEventTypeTable.size()) ? kEventTypeTable[type] : dr4::Event::Type::UNKNOWN;
+    }
+
+    inline dr4::MouseButtonType TranslateMouseButton(sf::Mouse::Button button) {
+        return ((size_t)button < kMouseButtonTable.size()) ? kMouseButtonTable[button]
+                                                           : dr4::MouseButtonType::UNKNOWN;
+    }
+
+    inline dr4::KeyCode TranslateKeyCode(sf::Keyboard::Scan::Scancode code) {
+        return ((size_t)code < kKeyCodeTable.size()) ? kKeyCodeTable[code] : dr4::KeyCode::KEYCODE_UNKNOWN;
+    }
+
 };
 
 #endif // TABLE_EVENT_HPP
@@ -0,0 +1,132 @@
+#ifndef TILE_RENDERER_HPP
+#define TILE_RENDERER_HPP
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "soft_raster.hpp"
+
+namespace graphics {
+namespace soft {
+
+    // Fixed set of workers, each with its own task deque. A worker takes tasks from the
+    // back of its deque and steals from the front of the others when it runs dry.
+    class WorkStealingPool {
+        private:
+            struct TaskQueue {
+                std::mutex mutex;
+                std::deque<size_t> tasks;
+            };
+
+            std::vector<std::thread> threads_;
+            // One queue per worker and the last one for the thread calling ParallelFor
+            std::vector<std::unique_ptr<TaskQueue>> queues_;
+
+            std::mutex mutex_;
+            std::condition_variable wake_;
+            std::condition_variable done_;
+
+            const std::function<void(size_t)>* task_;
+            size_t generation_;
+            std::atomic<size_t> remaining_;
+            bool stop_;
+
+            bool PopTask(size_t self, size_t& index);
+            void RunTasks(size_t self);
+            void WorkerLoop(size_t self);
+
+        public:
+            explicit WorkStealingPool(size_t thread_count);
+
+            WorkStealingPool(const WorkStealingPool& other) = delete;
+            WorkStealingPool& operator=(const WorkStealingPool& other) = delete;
+
+            ~WorkStealingPool();
+
+            // One worker per core besides the calling thread
+            static WorkStealingPool& Get();
+
+            // Runs task(i) for every i in [0, count) and returns when all are done,
+            // the calling thread works too. Not reentrant.
+            void ParallelFor(size_t count, const std::function<void(size_t)>& task);
+
+            size_t GetThreadCount() const {return threads_.size() + 1;};
+    };
+
+    const unsigned kTileSize = 64;
+
+    // Draw commands of one Texture recorded in painter's order. Flush bins them into
+    // kTileSize tiles and rasterizes the tiles in parallel, each tile runs its commands
+    // in the original order clipped to the tile, so the result matches immediate drawing.
+    class TileRenderer {
+        private:
+            enum class CommandType {
+                FILL_RECT,
+                FILL_PATH,
+                BLIT_MASK,
+                BLIT_SURFACE,
+            };
+
+            struct Command {
+                CommandType type;
+                // Pixels the command can touch, already inside clip
+                ClipRect bounds;
+                ClipRect clip;
+                dr4::Color color;
+
+                float rect[4];
+                PathPoint offset;
+
+                // Ranges in contours_ or masks_
+                size_t first;
+                size_t count;
+                unsigned width;
+                unsigned height;
+
+                std::shared_ptr<const Surface> source;
+            };
+
+            std::vector<Command> commands_;
+
+            // Everything a command refers to is copied (or referenced for copy-on-write
+            // surfaces) at record time, so drawables and fonts can change or die before the flush
+            std::vector<Contour> contours_;
+            std::vector<uint8_t> masks_;
+
+            std::vector<std::vector<uint32_t>> bins_;
+            std::vector<size_t> busy_tiles_;
+
+            void RunCommand(Surface& surface, const Command& command, const ClipRect& tile) const;
+
+        public:
+            explicit TileRenderer();
+
+            void RecordFillRect(float left, float top, float right, float bottom,
+                                dr4::Color color, const ClipRect& clip);
+            void RecordFillPath(const Contour* contours, size_t count, PathPoint offset,
+                                dr4::Color color, const ClipRect& clip);
+            void RecordBlitMask(const uint8_t* mask, unsigned width, unsigned height, int x, int y,
+                                dr4::Color color, const ClipRect& clip);
+            void RecordBlitSurface(const std::shared_ptr<const Surface>& source, int x, int y,
+                                   const ClipRect& clip);
+
+            bool IsEmpty() const {return commands_.empty();};
+            size_t GetCommandCount() const {return commands_.size();};
+
+            // Drops recorded commands without drawing them
+            void Discard();
+            void Flush(Surface& surface);
+    };
+
+};
+};
+
+#endif // TILE_RENDERER_HPP
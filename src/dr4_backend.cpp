@@ -6,6 +6,15 @@ extern "C" cum::Plugin* CREATE_PLUGIN_FUNC_NAME() {
     return new graphics::Backend();
 }
 
+graphics::Backend::Backend()
+    :offscreen_(graphics::IsOffscreenRequested()) {}
+
+graphics::Backend::~Backend() {
+    graphics::RenderTexturePool::Get().Clear();
+}
+
 dr4::Window *graphics::Backend::CreateWindow() {
-    return new graphics::RenderWindow();
+    graphics::RenderWindow* window = new graphics::RenderWindow();
+    window->SetOffscreen(offscreen_);
+    return window;
 }
@@ -0,0 +1,11 @@
+#include "../include/dr4_soft_backend.hpp"
+#include "../include/graphics_soft.hpp"
+#include "../mipt-ded-zemax/include/cum/manager.hpp"
+
+extern "C" cum::Plugin* CREATE_PLUGIN_FUNC_NAME() {
+    return new graphics::soft::Backend();
+}
+
+dr4::Window *graphics::soft::Backend::CreateWindow() {
+    return new graphics::soft::RenderWindow();
+}
@@ -0,0 +1,269 @@
+#include "../include/event_record.hpp"
+
+#include <string.h>
+#include <math.h>
+#include <stdexcept>
+
+namespace graphics {
+
+    static const size_t kMaxEventText = 255;
+
+//-----------------EVENT RECORDER-----------------------------------------------------------------------------
+
+    EventRecorder::EventRecorder(const std::string& path)
+        :file_(fopen(path.c_str(), "wb")), path_(path), last_time_(0), started_(false) {
+        if (file_ == NULL) {
+            throw std::runtime_error("Can't create event log " + path);
+        }
+
+        uint8_t header[8] = {};
+        memcpy(header, kEventLogMagic, sizeof(kEventLogMagic));
+        header[4] = kEventLogVersion & 0xff;
+        header[5] = kEventLogVersion >> 8;
+        WriteBytes(header, sizeof(header));
+    }
+
+    EventRecorder::~EventRecorder() {
+        fclose(file_);
+    }
+
+    void EventRecorder::WriteBytes(const void* data, size_t size) {
+        if (fwrite(data, 1, size, file_) != size) {
+            throw std::runtime_error("Can't write event log " + path_);
+        }
+    }
+
+    void EventRecorder::WriteVarint(uint64_t value) {
+        uint8_t bytes[10] = {};
+        size_t count = 0;
+        do {
+            bytes[count] = (value & 0x7f) | ((value >= 0x80) ? 0x80 : 0);
+            value >>= 7;
+            count++;
+        } while (value != 0);
+        WriteBytes(bytes, count);
+    }
+
+    void EventRecorder::WriteFloat(float value) {
+        uint32_t bits = 0;
+        memcpy(&bits, &value, sizeof(bits));
+        uint8_t bytes[4] = {(uint8_t)bits, (uint8_t)(bits >> 8), (uint8_t)(bits >> 16), (uint8_t)(bits >> 24)};
+        WriteBytes(bytes, sizeof(bytes));
+    }
+
+    void EventRecorder::Write(const dr4::Event& event, double time) {
+        if (!started_) {
+            last_time_ = time;
+            started_ = true;
+        }
+        double delta = (time > last_time_) ? time - last_time_ : 0;
+        WriteVarint((uint64_t)llround(delta * 1e6));
+        // Deltas are rounded against the rounded clock, so errors don't add up
+        last_time_ += llround(delta * 1e6) * 1e-6;
+
+        uint8_t type = (uint8_t)event.type;
+        WriteBytes(&type, 1);
+
+        switch (event.type) {
+            case dr4::Event::Type::KEY_DOWN : case dr4::Event::Type::KEY_UP : {
+                uint32_t sym = (uint32_t)(int32_t)event.key.sym;
+                uint8_t bytes[6] = {(uint8_t)sym, (uint8_t)(sym >> 8), (uint8_t)(sym >> 16), (uint8_t)(sym >> 24),
+                                    (uint8_t)event.key.mods, (uint8_t)(event.key.mods >> 8)};
+                WriteBytes(bytes, sizeof(bytes));
+                break;
+            }
+            case dr4::Event::Type::MOUSE_DOWN : case dr4::Event::Type::MOUSE_UP : {
+                uint8_t button = (uint8_t)event.mouseButton.button;
+                WriteBytes(&button, 1);
+                WriteFloat(event.mouseButton.pos.x);
+                WriteFloat(event.mouseButton.pos.y);
+                break;
+            }
+            case dr4::Event::Type::MOUSE_MOVE : {
+                WriteFloat(event.mouseMove.pos.x);
+                WriteFloat(event.mouseMove.pos.y);
+                WriteFloat(event.mouseMove.rel.x);
+                WriteFloat(event.mouseMove.rel.y);
+                break;
+            }
+            case dr4::Event::Type::MOUSE_WHEEL : {
+                WriteFloat(event.mouseWheel.delta.x);
+                WriteFloat(event.mouseWheel.delta.y);
+                WriteFloat(event.mouseWheel.pos.x);
+                WriteFloat(event.mouseWheel.pos.y);
+                break;
+            }
+            case dr4::Event::Type::TEXT_EVENT : {
+                size_t length = (event.text.unicode != NULL) ? strnlen(event.text.unicode, kMaxEventText) : 0;
+                uint8_t byte_length = length;
+                WriteBytes(&byte_length, 1);
+                WriteBytes(event.text.unicode, length);
+                break;
+            }
+            default : {
+                break;
+            }
+        }
+    }
+
+    void EventRecorder::Flush() {
+        fflush(file_);
+    }
+
+//-----------------EVENT REPLAYER-----------------------------------------------------------------------------
+
+    // Bounds-checked little-endian reads over the loaded file
+    class EventLogReader {
+        private:
+            const std::vector<uint8_t>& data_;
+            const std::string& path_;
+            size_t pos_;
+
+        public:
+            explicit EventLogReader(const std::vector<uint8_t>& data, const std::string& path)
+                :data_(data), path_(path), pos_(0) {};
+
+            bool AtEnd() const {return pos_ == data_.size();};
+
+            const uint8_t* Take(size_t size) {
+                if (data_.size() - pos_ < size) {
+                    throw std::runtime_error("Truncated event log " + path_);
+                }
+                const uint8_t* bytes = data_.data() + pos_;
+                pos_ += size;
+                return bytes;
+            };
+
+            uint8_t Byte() {
+                return *Take(1);
+            };
+
+            uint32_t Uint32() {
+                const uint8_t* bytes = Take(4);
+                return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+            };
+
+            float Float() {
+                uint32_t bits = Uint32();
+                float value = 0;
+                memcpy(&value, &bits, sizeof(value));
+                return value;
+            };
+
+            uint64_t Varint() {
+                uint64_t value = 0;
+                for (unsigned shift = 0; shift < 64; shift += 7) {
+                    uint8_t byte = Byte();
+                    value |= (uint64_t)(byte & 0x7f) << shift;
+                    if ((byte & 0x80) == 0) {
+                        return value;
+                    }
+                }
+                throw std::runtime_error("Bad time in event log " + path_);
+            };
+    };
+
+    static std::vector<uint8_t> ReadFile(const std::string& path) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == NULL) {
+            throw std::runtime_error("Can't open event log " + path);
+        }
+
+        std::vector<uint8_t> data;
+        uint8_t chunk[4096];
+        size_t count = 0;
+        while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            data.insert(data.end(), chunk, chunk + count);
+        }
+        bool failed = ferror(file);
+        fclose(file);
+        if (failed) {
+            throw std::runtime_error("Can't read event log " + path);
+        }
+        return data;
+    }
+
+    EventReplayer::EventReplayer(const std::string& path, double speed, double start_time)
+        :events_(), texts_(), next_(0), speed_(speed), start_time_(start_time) {
+        std::vector<uint8_t> data = ReadFile(path);
+        EventLogReader reader(data, path);
+
+        const uint8_t* header = reader.Take(8);
+        if (memcmp(header, kEventLogMagic, sizeof(kEventLogMagic)) != 0) {
+            throw std::runtime_error(path + " is not an event log");
+        }
+        if ((header[4] | (header[5] << 8)) != kEventLogVersion) {
+            throw std::runtime_error("Unsupported event log version in " + path);
+        }
+
+        uint64_t time = 0;
+        while (!reader.AtEnd()) {
+            time += reader.Varint();
+
+            RecordedEvent record;
+            record.time = time * 1e-6;
+            record.event.type = (dr4::Event::Type)reader.Byte();
+
+            switch (record.event.type) {
+                case dr4::Event::Type::KEY_DOWN : case dr4::Event::Type::KEY_UP : {
+                    record.event.key.sym = (dr4::KeyCode)(int32_t)reader.Uint32();
+                    record.event.key.mods = reader.Byte();
+                    record.event.key.mods |= reader.Byte() << 8;
+                    break;
+                }
+                case dr4::Event::Type::MOUSE_DOWN : case dr4::Event::Type::MOUSE_UP : {
+                    record.event.mouseButton.button = (dr4::MouseButtonType)reader.Byte();
+                    record.event.mouseButton.pos.x = reader.Float();
+                    record.event.mouseButton.pos.y = reader.Float();
+                    break;
+                }
+                case dr4::Event::Type::MOUSE_MOVE : {
+                    record.event.mouseMove.pos.x = reader.Float();
+                    record.event.mouseMove.pos.y = reader.Float();
+                    record.event.mouseMove.rel.x = reader.Float();
+                    record.event.mouseMove.rel.y = reader.Float();
+                    break;
+                }
+                case dr4::Event::Type::MOUSE_WHEEL : {
+                    record.event.mouseWheel.delta.x = reader.Float();
+                    record.event.mouseWheel.delta.y = reader.Float();
+                    record.event.mouseWheel.pos.x = reader.Float();
+                    record.event.mouseWheel.pos.y = reader.Float();
+                    break;
+                }
+                case dr4::Event::Type::TEXT_EVENT : {
+                    size_t length = reader.Byte();
+                    const uint8_t* text = reader.Take(length);
+                    texts_.emplace_back((const char*)text, length);
+                    record.event.text.unicode = texts_.back().c_str();
+                    break;
+                }
+                case dr4::Event::Type::UNKNOWN : case dr4::Event::Type::QUIT : {
+                    break;
+                }
+                default : {
+                    throw std::runtime_error("Unknown event type in event log " + path);
+                }
+            }
+
+            events_.push_back(record);
+        }
+    }
+
+    std::optional<dr4::Event> EventReplayer::Next(double now, double& event_time) {
+        if (IsFinished()) {
+            return {};
+        }
+
+        const RecordedEvent& record = events_[next_];
+        double scheduled_time = (speed_ > 0) ? start_time_ + record.time / speed_ : now;
+        if (now < scheduled_time) {
+            return {};
+        }
+
+        event_time = scheduled_time;
+        next_++;
+        return record.event;
+    }
+
+}
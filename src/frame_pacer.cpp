@@ -0,0 +1,139 @@
+#include "../include/frame_pacer.hpp"
+
+#include <math.h>
+#include <algorithm>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace graphics {
+
+    static const std::chrono::microseconds kSleepSlice(1000);
+    // Pessimistic until two measurements give a deviation, it isn't one of the samples
+    static const double kStartSleepEstimate = 5e-3;
+
+    // Running mean and deviation of how long one kSleepSlice actually takes
+    struct SleepEstimator {
+        double estimate = kStartSleepEstimate;
+        double mean = 0;
+        double m2 = 0;
+        size_t count = 0;
+
+        void Update(double observed) {
+            count++;
+            double delta = observed - mean;
+            mean += delta / count;
+            m2 += delta * (observed - mean);
+            if (count >= 2) {
+                estimate = mean + sqrt(m2 / (count - 1));
+            }
+        }
+    };
+
+    static inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    uint64_t MonotonicNanoseconds() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            MonotonicClock::now().time_since_epoch()).count();
+    }
+
+    double MonotonicSeconds() {
+        return MonotonicNanoseconds() * 1e-9;
+    }
+
+    void PreciseSleepUntil(MonotonicClock::time_point deadline) {
+        thread_local SleepEstimator estimator;
+
+        while (true) {
+            MonotonicClock::time_point now = MonotonicClock::now();
+            double remaining = std::chrono::duration<double>(deadline - now).count();
+            if (remaining <= estimator.estimate) {
+                break;
+            }
+
+            std::this_thread::sleep_for(kSleepSlice);
+            estimator.Update(std::chrono::duration<double>(MonotonicClock::now() - now).count());
+        }
+
+        while (MonotonicClock::now() < deadline) {
+            CpuRelax();
+        }
+    }
+
+    void PreciseSleep(double seconds) {
+        if (seconds <= 0) {
+            return;
+        }
+        PreciseSleepUntil(MonotonicClock::now()
+                          + std::chrono::duration_cast<MonotonicClock::duration>(std::chrono::duration<double>(seconds)));
+    }
+
+//-----------------FRAME PACER--------------------------------------------------------------------------------
+
+    FramePacer::FramePacer(double period)
+        :period_(), next_deadline_(), started_(false), stats_(), jitter_m2_(0) {
+        SetPeriod(period);
+        ResetStats();
+    }
+
+    void FramePacer::SetPeriod(double period) {
+        period_ = std::chrono::duration_cast<MonotonicClock::duration>(
+            std::chrono::duration<double>(std::max(0.0, period)));
+        started_ = false;
+    }
+
+    double FramePacer::GetPeriod() const {
+        return std::chrono::duration<double>(period_).count();
+    }
+
+    void FramePacer::Reset() {
+        started_ = false;
+    }
+
+    void FramePacer::ResetStats() {
+        stats_ = {0, 0, 0, 0, 0};
+        jitter_m2_ = 0;
+    }
+
+    void FramePacer::AddJitter(double jitter) {
+        stats_.frames++;
+        double delta = jitter - stats_.mean_jitter;
+        stats_.mean_jitter += delta / stats_.frames;
+        jitter_m2_ += delta * (jitter - stats_.mean_jitter);
+        stats_.jitter_stddev = (stats_.frames > 1) ? sqrt(jitter_m2_ / (stats_.frames - 1)) : 0;
+        stats_.max_jitter = std::max(stats_.max_jitter, jitter);
+    }
+
+    void FramePacer::WaitNextFrame() {
+        if (period_ == MonotonicClock::duration::zero()) {
+            return;
+        }
+
+        MonotonicClock::time_point now = MonotonicClock::now();
+        if (!started_) {
+            started_ = true;
+            next_deadline_ = now + period_;
+            return;
+        }
+
+        // Late frame: catching up would make the next ones short, start over instead
+        if (now >= next_deadline_) {
+            stats_.missed++;
+            next_deadline_ = now + period_;
+            return;
+        }
+
+        PreciseSleepUntil(next_deadline_);
+        AddJitter(std::chrono::duration<double>(MonotonicClock::now() - next_deadline_).count());
+        next_deadline_ += period_;
+    }
+
+}
@@ -1,10 +1,13 @@
 #include "../include/graphics.hpp"
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <stdexcept>
 #include <string.h>
 #include <memory>
-#include <unistd.h>
+#include <algorithm>
+#include <unordered_map>
+#include <thread>
 
 #include <SFML/Graphics/Vertex.hpp>
 #include <SFML/Graphics.hpp>
@@ -14,9 +17,57 @@
 #include "../geometry/include/vector.hpp"
 
 #include "../include/table_event.hpp"
+#include "../include/pixels.hpp"
+#include "../include/glyph_layout.hpp"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <unistd.h>
+
+extern "C" int XInitThreads(void);
+extern "C" _XDisplay* glXGetCurrentDisplay(void);
+extern "C" int XConnectionNumber(_XDisplay* display);
+extern "C" int XEventsQueued(_XDisplay* display, int mode);
+// QueuedAlready of Xlib: count the read events without touching the connection
+static const int kXQueuedAlready = 0;
+#endif
 
 namespace graphics {
 
+#if defined(__linux__)
+    // Both ends are non-blocking: a pipe that is already full wakes the reader anyway.
+    // The pipes live as long as the window, so other threads can write at any time.
+    static void OpenWakePipe(int fds[2]) {
+        if (fds[0] < 0 && pipe2(fds, O_NONBLOCK | O_CLOEXEC) != 0) {
+            fds[0] = -1;
+            fds[1] = -1;
+        }
+    }
+
+    static void CloseWakePipe(int fds[2]) {
+        if (fds[0] >= 0) {
+            ::close(fds[0]);
+            ::close(fds[1]);
+            fds[0] = -1;
+            fds[1] = -1;
+        }
+    }
+
+    static void WakePipe(const int fds[2]) {
+        if (fds[1] >= 0) {
+            char wake = 0;
+            (void)!::write(fds[1], &wake, sizeof(wake));
+        }
+    }
+
+    static void DrainWakePipe(const int fds[2]) {
+        char buffer[64];
+        while (fds[0] >= 0 && ::read(fds[0], buffer, sizeof(buffer)) > 0) {}
+    }
+#endif
+
 //-----------------FONT---------------------------------------------------------------------------------------
 
     class FontImpl : public sf::Font {
@@ -27,19 +78,52 @@ namespace graphics {
             virtual ~FontImpl() = default;
     };
 
+    // Never 0, so the generation of a Text without a font matches no font
+    static size_t NextFontGeneration() {
+        static std::atomic<size_t> last_generation(0);
+        return last_generation.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    Font::Font()
+        :generation_(NextFontGeneration()) {};
+
     Font::~Font() {};
 
     void Font::LoadFromFile(const std::string& path) {
+        generation_ = NextFontGeneration();
+        sdf_atlas_.reset();
         if (!(sf::Font::loadFromFile(path))) {
             throw std::runtime_error("No files for font uploading");
         }
     };
     void Font::LoadFromBuffer(const void* buffer, size_t size)  {
+        generation_ = NextFontGeneration();
+        sdf_atlas_.reset();
         if (!(sf::Font::loadFromMemory(buffer, size))) {
             throw std::runtime_error("No files for font uploading");
         }
     };
 
+    void Font::SetSdfMode(bool enabled) {
+        if (enabled == sdf_enabled_) {
+            return;
+        }
+        generation_ = NextFontGeneration();
+        sdf_enabled_ = enabled;
+        sdf_atlas_.reset();
+    }
+
+    bool Font::IsSdf() const {
+        return sdf_enabled_ && SdfAtlas::GetShader() != NULL;
+    }
+
+    SdfAtlas* Font::GetSdfAtlas() const {
+        if (sdf_atlas_ == NULL) {
+            sdf_atlas_ = std::make_unique<SdfAtlas>(*this);
+        }
+        return sdf_atlas_.get();
+    }
+
     float Font::GetAscent(float fontSize) const {
         return sf::Font::getLineSpacing(fontSize) - sf::Font::getUnderlinePosition(fontSize);
     };
@@ -49,15 +133,85 @@ namespace graphics {
 
 //-----------------TEXT---------------------------------------------------------------------------------------
 
+    // Quads for every glyph of the page for this character size
+    static sf::FloatRect BuildGlyphVertices(const sf::Font& font, const sf::String& string, unsigned size,
+                                            std::vector<sf::Vertex>& vertices) {
+        auto kerning = [&](sf::Uint32 prev, sf::Uint32 codepoint) {
+            return font.getKerning(prev, codepoint, size);
+        };
+        auto glyph_lookup = [&](sf::Uint32 codepoint) {
+            const sf::Glyph& glyph = font.getGlyph(codepoint, size, false);
+            return LayoutGlyph{glyph.advance, glyph.bounds, glyph.bounds, sf::FloatRect(glyph.textureRect)};
+        };
+        return LayoutGlyphs(string, size, font.getGlyph(L' ', size, false).advance, font.getLineSpacing(size),
+                            sf::Color::White, kerning, glyph_lookup, vertices);
+    }
+
+    // Layouts shared between all labels with the same font, size and string
+    class TextLayoutCache {
+        private:
+            // A font generation is unique in the process, a new font at a freed address doesn't match
+            struct Key {
+                size_t font_generation;
+                unsigned size;
+                std::string text;
+
+                bool operator==(const Key& other) const {
+                    return font_generation == other.font_generation && size == other.size && text == other.text;
+                };
+            };
+
+            struct KeyHash {
+                size_t operator()(const Key& key) const {
+                    size_t hash = std::hash<std::string>()(key.text);
+                    hash ^= std::hash<size_t>()(key.font_generation * 31 + key.size) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+                    return hash;
+                };
+            };
+
+            std::unordered_map<Key, TextLayout, KeyHash> layouts_;
+
+        public:
+            static TextLayoutCache& Get() {
+                static TextLayoutCache cache;
+                return cache;
+            };
+
+            // The reference is valid until the next call
+            const TextLayout& GetLayout(const sf::Text& text, const Font* font, const std::string& string) {
+                Key key = {font->GetGeneration(), text.getCharacterSize(), string};
+
+                auto layout_itr = layouts_.find(key);
+                if (layout_itr != layouts_.end()) {
+                    return layout_itr->second;
+                }
+
+                if (layouts_.size() >= kTextLayoutCacheCapacity) {
+                    layouts_.clear();
+                }
+
+                TextLayout layout;
+                if (font->IsSdf()) {
+                    layout.bounds = font->GetSdfAtlas()->BuildVertices(text.getString(), key.size,
+                                                                      sf::Color::White, layout.vertices);
+                } else {
+                    layout.bounds = BuildGlyphVertices(*font, text.getString(), key.size, layout.vertices);
+                }
+                return layouts_.emplace(std::move(key), std::move(layout)).first->second;
+            };
+    };
+
     Text::Text()
-        :sf::Text(), pos_({0, 0}) {
+        :sf::Text(), pos_({0, 0}), bounds_(), bounds_valid_(false), layout_dirty_(true), font_generation_(0) {
         font_ = NULL;
         text_ = "";
         valign_ = dr4::Text::VAlign::TOP;
     }
 
     Text::Text(const Text& other)
-        :sf::Text(other), font_(other.font_) {
+        :sf::Text(other), font_(other.font_), pos_(other.pos_), bounds_(other.bounds_),
+         bounds_valid_(other.bounds_valid_), layout_dirty_(other.layout_dirty_),
+         font_generation_(other.font_generation_), vertices_(other.vertices_) {
         sf::Text::setFont(*font_);
         text_ = other.text_;
         valign_ = other.valign_;
@@ -66,27 +220,39 @@ namespace graphics {
     Text::~Text() {}
 
     void Text::SetText(const std::string& new_text) {
+        if (new_text == text_) {
+            return;
+        }
         sf::Text::setString(sf::String::fromUtf8(new_text.begin(), new_text.end()));
         text_ = new_text;
+        bounds_valid_ = false;
+        layout_dirty_ = true;
     }
     void Text::SetColor(dr4::Color color) {
         sf::Text::setFillColor({color.r, color.g, color.b, color.a});
+        for (sf::Vertex& vertex : vertices_) {
+            vertex.color = {color.r, color.g, color.b, color.a};
+        }
     }
     void Text::SetFontSize(float size) {
         sf::Text::setCharacterSize(size);
+        bounds_valid_ = false;
+        layout_dirty_ = true;
     }
     void Text::SetVAlign(dr4::Text::VAlign valign) {
         valign_ = valign;
-        ChangeValign();
+        layout_dirty_ = true;
     }
     void Text::SetFont(const dr4::Font* font) {
         font_ = dynamic_cast<const Font*>(font);
         sf::Text::setFont(*font_);
+        bounds_valid_ = false;
+        layout_dirty_ = true;
     }
 
     dr4::Vec2f Text::GetBounds() const {
-        auto size = sf::Text::getLocalBounds().getSize();
-        return {size.x, size.y};
+        UpdateLayout();
+        return {bounds_.width, bounds_.height};
     }
     const std::string& Text::GetText() const {
         return text_;
@@ -107,32 +273,76 @@ namespace graphics {
 
     void Text::SetPos(dr4::Vec2f pos) {
         pos_ = pos;
-        ChangeValign();
+        layout_dirty_ = true;
     }
     dr4::Vec2f Text::GetPos() const {
         return pos_;
     }
 
     void Text::DrawOn(dr4::Texture& texture) const {
+        if (font_ == NULL) {
+            return;
+        }
+
+        UpdateLayout();
         auto& my_texture = dynamic_cast<Texture&>(texture);
-        my_texture.draw(*this, sf::RenderStates().transform.translate(
-            {my_texture.extent_.x, my_texture.extent_.y}
-        ));
+
+        sf::Transform transform;
+        transform.translate({my_texture.extent_.x, my_texture.extent_.y});
+        transform.combine(sf::Text::getTransform());
+
+        if (font_->IsSdf()) {
+            my_texture.AppendVertices(vertices_.data(), vertices_.size(), transform,
+                                      &font_->GetSdfAtlas()->GetTexture(), SdfAtlas::GetShader());
+        } else {
+            my_texture.AppendVertices(vertices_.data(), vertices_.size(), transform,
+                                      &font_->getTexture(sf::Text::getCharacterSize()));
+        }
+    }
+
+    void Text::UpdateLayout() const {
+        if (font_ != NULL && font_->GetGeneration() != font_generation_) {
+            font_generation_ = font_->GetGeneration();
+            bounds_valid_ = false;
+        }
+
+        if (!bounds_valid_) {
+            vertices_.clear();
+            if (font_ == NULL) {
+                bounds_ = sf::FloatRect();
+            } else {
+                const TextLayout& layout = TextLayoutCache::Get().GetLayout(*this, font_, text_);
+                bounds_ = layout.bounds;
+                vertices_ = layout.vertices;
+
+                sf::Color color = sf::Text::getFillColor();
+                for (sf::Vertex& vertex : vertices_) {
+                    vertex.color = color;
+                }
+            }
+            bounds_valid_ = true;
+            layout_dirty_ = true;
+        }
+
+        if (layout_dirty_) {
+            const_cast<Text*>(this)->ChangeValign();
+            layout_dirty_ = false;
+        }
     }
 
     void Text::ChangeValign() {
         switch(valign_) {
             case dr4::Text::VAlign::BASELINE : {
-                sf::Text::setPosition({pos_.x, pos_.y - sf::Text::getLocalBounds().height
+                sf::Text::setPosition({pos_.x, pos_.y - bounds_.height
                                                       + font_->getUnderlinePosition(sf::Text::getCharacterSize())});
                 return;
             }
             case dr4::Text::VAlign::BOTTOM : {
-                sf::Text::setPosition({pos_.x, pos_.y - sf::Text::getLocalBounds().height});
+                sf::Text::setPosition({pos_.x, pos_.y - bounds_.height});
                 return;
             }
             case dr4::Text::VAlign::MIDDLE : {
-                sf::Text::setPosition({pos_.x, pos_.y - sf::Text::getLocalBounds().height / 2});
+                sf::Text::setPosition({pos_.x, pos_.y - bounds_.height / 2});
                 return;
             }
             case dr4::Text::VAlign::TOP : {
@@ -192,10 +402,7 @@ namespace graphics {
     }
 
     void Line::DrawOn(dr4::Texture& texture) const {
-        auto& my_texture = dynamic_cast<Texture&>(texture);
-        my_texture.draw(*this, sf::RenderStates().transform.translate(
-            {my_texture.extent_.x, my_texture.extent_.y}
-        ));
+        dynamic_cast<Texture&>(texture).AppendShape(*this);
     }
 
     void Line::SetPos(dr4::Vec2f pos) {
@@ -249,10 +456,7 @@ namespace graphics {
     }
 
     void Circle::DrawOn(dr4::Texture& texture) const {
-        auto& my_texture = dynamic_cast<Texture&>(texture);
-        my_texture.draw(*this, sf::RenderStates().transform.translate(
-            {my_texture.extent_.x, my_texture.extent_.y}
-        ));
+        dynamic_cast<Texture&>(texture).AppendShape(*this);
     }
 
     void Circle::SetPos(dr4::Vec2f pos) {
@@ -318,36 +522,47 @@ namespace graphics {
     }
 
     void RectangleShape::DrawOn(dr4::Texture& texture) const {
-        auto& my_texture = dynamic_cast<Texture&>(texture);
-        my_texture.draw(*this, sf::RenderStates().transform.translate(
-            {my_texture.extent_.x, my_texture.extent_.y}
-        ));
+        dynamic_cast<Texture&>(texture).AppendShape(*this);
     }
 
 //-----------------IMAGE--------------------------------------------------------------------------------------
 
     Image::Image(float width, float height)
-        :sf::Image() {
+        :sf::Image(), texture_valid_(false) {
         sf::Image::create(width, height);
 
         width_ = width;
         height_ = height;
 
         pos_ = {0, 0};
+        ResetDirty();
     }
 
     Image::Image(const sf::Image& other)
-        :sf::Image(other) {
+        :sf::Image(other), texture_valid_(false) {
         width_ = other.getSize().x;
         height_ = other.getSize().y;
 
         pos_ = {0, 0};
+        ResetDirty();
+    }
+
+    Image::Image(unsigned width, unsigned height, const sf::Uint8* pixels)
+        :sf::Image(), texture_valid_(false) {
+        sf::Image::create(width, height, pixels);
+
+        width_ = width;
+        height_ = height;
+
+        pos_ = {0, 0};
+        ResetDirty();
     }
 
     Image::~Image() {}
 
     void Image::SetPixel(size_t x, size_t y, dr4::Color color) {
         sf::Image::setPixel(x, y, sf::Color(color.r, color.g, color.b, color.a));
+        MarkDirty(x, y, x + 1, y + 1);
     }
 
     dr4::Color Image::GetPixel(size_t x, size_t y) const {
@@ -359,6 +574,8 @@ namespace graphics {
         width_ = size.x;
         height_ = size.y;
         sf::Image::create(width_, height_);
+        texture_valid_ = false;
+        ResetDirty();
     }
     dr4::Vec2f Image::GetSize() const {
         return dr4::Vec2f(width_, height_);
@@ -379,40 +596,173 @@ namespace graphics {
 
     void Image::DrawOn(dr4::Texture& texture) const {
         Texture& my_texture = dynamic_cast<Texture&>(texture);
-        sf::Texture txtr;
-        txtr.loadFromImage(*this);
-        sf::Sprite sprite(txtr);
+        UploadTexture();
+        sf::Sprite sprite(texture_);
         sprite.setPosition(
             {my_texture.extent_.x + pos_.x, my_texture.extent_.y + pos_.y}
         );
-        my_texture.draw(sprite);
+        my_texture.DrawDirect(sprite, kSpriteVertexCount);
+    }
+
+    PixelRegion Image::LockRegion(unsigned left, unsigned top, unsigned width, unsigned height) {
+        sf::Vector2u size = sf::Image::getSize();
+        if (left > size.x || width > size.x - left || top > size.y || height > size.y - top) {
+            throw std::runtime_error("Locked region is out of image bounds");
+        }
+
+        sf::Uint8* pixels = const_cast<sf::Uint8*>(sf::Image::getPixelsPtr());
+        return {pixels + ((size_t)top * size.x + left) * 4, (size_t)size.x * 4, left, top, width, height};
+    }
+
+    void Image::UnlockRegion(const PixelRegion& region) {
+        MarkDirty(region.left, region.top, region.left + region.width, region.top + region.height);
+    }
+
+    void Image::WriteRow(unsigned x, unsigned y, const dr4::Color* colors, size_t count) {
+        sf::Vector2u size = sf::Image::getSize();
+        if (x > size.x || count > size.x - x || y >= size.y) {
+            throw std::runtime_error("Written row is out of image bounds");
+        }
+
+        // count fits the image width now
+        PixelRegion region = LockRegion(x, y, (unsigned)count, 1);
+        ColorsToRgba8(colors, region.pixels, count);
+        UnlockRegion(region);
+    }
+
+    void Image::ReadRow(unsigned x, unsigned y, dr4::Color* colors, size_t count) const {
+        sf::Vector2u size = sf::Image::getSize();
+        if (x > size.x || count > size.x - x || y >= size.y) {
+            throw std::runtime_error("Read row is out of image bounds");
+        }
+
+        Rgba8ToColors(sf::Image::getPixelsPtr() + ((size_t)y * size.x + x) * 4, colors, count);
+    }
+
+    void Image::FillRegion(unsigned left, unsigned top, unsigned width, unsigned height, dr4::Color color) {
+        PixelRegion region = LockRegion(left, top, width, height);
+        for (unsigned row = 0; row < height; row++) {
+            FillRgba8(region.pixels + row * region.stride, color, width);
+        }
+        UnlockRegion(region);
+    }
+
+    void Image::MarkDirty(unsigned left, unsigned top, unsigned right, unsigned bottom) {
+        if (!texture_valid_) {
+            return;
+        }
+        dirty_left_   = std::min(dirty_left_,   left);
+        dirty_top_    = std::min(dirty_top_,    top);
+        dirty_right_  = std::max(dirty_right_,  right);
+        dirty_bottom_ = std::max(dirty_bottom_, bottom);
+    }
+
+    void Image::ResetDirty() const {
+        dirty_left_ = sf::Image::getSize().x;
+        dirty_top_ = sf::Image::getSize().y;
+        dirty_right_ = 0;
+        dirty_bottom_ = 0;
+    }
+
+    // Uploads the whole image once, afterwards only the dirty rectangle is sent
+    void Image::UploadTexture() const {
+        sf::Vector2u size = sf::Image::getSize();
+        if (size.x == 0 || size.y == 0) {
+            return;
+        }
+
+        if (!texture_valid_) {
+            TraceScope trace("Upload");
+            texture_.loadFromImage(*this);
+            texture_valid_ = true;
+            ResetDirty();
+            RenderStats::Get().CountUpload((size_t)size.x * size.y * 4);
+            return;
+        }
+
+        if (dirty_left_ >= dirty_right_ || dirty_top_ >= dirty_bottom_) {
+            return;
+        }
+
+        TraceScope trace("Upload");
+
+        unsigned width = dirty_right_ - dirty_left_;
+        unsigned height = dirty_bottom_ - dirty_top_;
+        const sf::Uint8* pixels = sf::Image::getPixelsPtr() + (dirty_top_ * size.x + dirty_left_) * 4;
+
+        if (width == size.x) {
+            texture_.update(pixels, width, height, dirty_left_, dirty_top_);
+        } else {
+            upload_buffer_.resize(width * height * 4);
+            for (unsigned row = 0; row < height; row++) {
+                memcpy(upload_buffer_.data() + row * width * 4, pixels + row * size.x * 4, width * 4);
+            }
+            texture_.update(upload_buffer_.data(), width, height, dirty_left_, dirty_top_);
+        }
+
+        ResetDirty();
+        RenderStats::Get().CountUpload((size_t)width * height * 4);
     }
 
 //-----------------TEXTURE------------------------------------------------------------------------------------
 
+    ResolveStats Texture::total_resolve_stats_ = {0, 0};
+
     Texture::Texture(float width, float height)
-        :sf::RenderTexture() {
+        :target_(NULL), batch_(sf::Triangles), batch_texture_(NULL), batch_shader_(NULL),
+         dirty_(true), resolve_stats_({0, 0}) {
         main_rect_.size.x = (width > kMinWidthTexture) ? width : kMinWidthTexture;
         main_rect_.size.y = (height > kMinWidthTexture) ? height : kMinWidthTexture;
-        sf::RenderTexture::create(main_rect_.size.x, main_rect_.size.y);
+        AcquireTarget(main_rect_.size);
         main_rect_.pos = {0, 0};
         clip_rect_ = main_rect_;
         extent_ = {0, 0};
     }
 
     Texture::Texture(const Texture& other)
-        :sf::RenderTexture() {
-        sf::RenderTexture::create(other.main_rect_.size.x, other.main_rect_.size.y);
+        :target_(NULL), batch_(sf::Triangles), batch_texture_(NULL), batch_shader_(NULL),
+         dirty_(true), resolve_stats_({0, 0}) {
         clip_rect_ = other.clip_rect_;
         main_rect_ = other.main_rect_;
+        AcquireTarget(main_rect_.size);
         extent_ = {0, 0};
     }
 
-    Texture::~Texture() {}
+    Texture::~Texture() {
+        RenderTexturePool::Get().Release(target_);
+    }
+
+    // Keeps the current target when the new size fits (grow-only capacity)
+    void Texture::AcquireTarget(dr4::Vec2f size) {
+        unsigned width = (size.x > 1) ? size.x : 1;
+        unsigned height = (size.y > 1) ? size.y : 1;
+
+        if (target_ == NULL || target_->getSize().x < width || target_->getSize().y < height) {
+            RenderTexturePool& pool = RenderTexturePool::Get();
+            pool.Release(target_);
+            target_ = pool.Acquire(width, height);
+        }
+
+        SetView(sf::View(sf::FloatRect(0, 0, width, height)));
+        target_->clear(sf::Color::Transparent);
+    }
+
+    // Every view is limited to the used part of the target
+    void Texture::SetView(sf::View view) {
+        sf::Vector2u capacity = target_->getSize();
+        view.setViewport(sf::FloatRect(0, 0, main_rect_.size.x / capacity.x, main_rect_.size.y / capacity.y));
+        target_->setView(view);
+    }
+
+    sf::IntRect Texture::GetTextureRect() const {
+        return sf::IntRect(0, 0, main_rect_.size.x, main_rect_.size.y);
+    }
 
     void Texture::SetSize(dr4::Vec2f size) {
+        batch_.clear();
         main_rect_.size = size;
-        sf::RenderTexture::create(size.x, size.y);
+        AcquireTarget(size);
+        dirty_ = true;
     }
 
     dr4::Vec2f Texture::GetSize() const {
@@ -429,13 +779,13 @@ namespace graphics {
 
     void Texture::DrawOn(dr4::Texture& texture) const {
         Texture& my_texture = dynamic_cast<Texture&>(texture);
-        (const_cast<Texture*>(this))->display();
+        (const_cast<Texture*>(this))->Display();
 
-        sf::Sprite sprite(sf::RenderTexture::getTexture());
+        sf::Sprite sprite(target_->getTexture(), GetTextureRect());
         sprite.setPosition(
             {main_rect_.pos.x + my_texture.extent_.x,
              main_rect_.pos.y + my_texture.extent_.y});
-        my_texture.draw(sprite);
+        my_texture.DrawDirect(sprite, kSpriteVertexCount);
     }
 
     void Texture::SetZero(dr4::Vec2f pos) {
@@ -453,12 +803,15 @@ namespace graphics {
     }
 
     void Texture::Clear(dr4::Color color) {
-        sf::RenderTexture::clear(sf::Color(color.r, color.g, color.b, color.a));
+        batch_.clear();
+        target_->clear(sf::Color(color.r, color.g, color.b, color.a));
+        dirty_ = true;
     }
 
     void Texture::SetClipRect(dr4::Rect2f rect) {
+        Flush();
         clip_rect_ = rect;
-        sf::RenderTexture::setView(
+        SetView(
             {{extent_.x + clip_rect_.pos.x + clip_rect_.size.x / 2,
               extent_.y + clip_rect_.pos.y + clip_rect_.size.y / 2},
              {clip_rect_.size.x, clip_rect_.size.y}}
@@ -466,9 +819,10 @@ namespace graphics {
     }
 
     void Texture::RemoveClipRect() {
+        Flush();
         clip_rect_.size = main_rect_.size;
         clip_rect_.pos = -extent_;
-        sf::RenderTexture::setView(
+        SetView(
             {{clip_rect_.size.x / 2, clip_rect_.size.y / 2},
              {clip_rect_.size.x,     clip_rect_.size.y    }}
         );
@@ -479,16 +833,241 @@ namespace graphics {
     }
 
     dr4::Image* Texture::GetImage() const {
-        (const_cast<Texture*>(this))->display();
-        sf::Texture txtr = sf::RenderTexture::getTexture();
+        sf::IntRect rect = GetTextureRect();
+        return GetImage({{0, 0}, {(float)rect.width, (float)rect.height}});
+    }
+
+    // Checked in floats before the conversion: NaN, negative or huge regions fail here
+    sf::IntRect Texture::ReadbackRegion(dr4::Rect2f region) const {
+        sf::IntRect rect = GetTextureRect();
+        if (!(region.pos.x >= 0 && region.pos.y >= 0 && region.size.x >= 1 && region.size.y >= 1
+              && region.pos.x + region.size.x <= rect.width && region.pos.y + region.size.y <= rect.height)) {
+            throw std::runtime_error("Readback region is out of texture bounds");
+        }
+        return sf::IntRect(region.pos.x, region.pos.y, region.size.x, region.size.y);
+    }
+
+    dr4::Image* Texture::GetImage(dr4::Rect2f region) const {
+        sf::IntRect rect = ReadbackRegion(region);
+        std::vector<sf::Uint8> pixels((size_t)rect.width * (size_t)rect.height * 4);
+        ReadPixels(region, pixels.data());
+        return new Image(rect.width, rect.height, pixels.data());
+    }
+
+    void Texture::ReadPixels(dr4::Rect2f region, sf::Uint8* pixels, size_t stride) const {
+        sf::IntRect rect = ReadbackRegion(region);
+        Texture* self = const_cast<Texture*>(this);
+        self->Display();
+
+        TraceScope trace("Readback");
+        graphics::ReadPixels(*target_, sf::Vector2u(GetTextureRect().width, GetTextureRect().height),
+                             rect, pixels, stride);
+        RenderStats::Get().CountReadback((size_t)rect.width * (size_t)rect.height * 4);
+    }
+
+    AsyncReadback* Texture::ReadPixelsAsync(dr4::Rect2f region) const {
+        sf::IntRect rect = ReadbackRegion(region);
+        Texture* self = const_cast<Texture*>(this);
+        self->Display();
+        return new AsyncReadback(*target_, sf::Vector2u(GetTextureRect().width, GetTextureRect().height), rect);
+    }
+
+    static sf::Vector2f ShapeEdgeNormal(sf::Vector2f p1, sf::Vector2f p2) {
+        sf::Vector2f normal(p1.y - p2.y, p2.x - p1.x);
+        float len = sqrtf(normal.x * normal.x + normal.y * normal.y);
+        if (len != 0.f) {
+            normal.x /= len;
+            normal.y /= len;
+        }
+        return normal;
+    }
+
+    // Same triangulation as sf::Shape: a fan around the bounds center for the fill
+    // and a strip of mitered quads for the outline, baked into target coordinates
+    void Texture::AppendShape(const sf::Shape& shape) {
+        sf::Transform transform;
+        transform.translate({extent_.x, extent_.y});
+        transform.combine(shape.getTransform());
+
+        if (shape.getTexture() != NULL) {
+            // sf::Shape draws a closed fan and, with an outline, a closed strip
+            size_t points = shape.getPointCount();
+            size_t vertices = points + 2 + ((shape.getOutlineThickness() != 0) ? (points + 1) * 2 : 0);
+            DrawDirect(shape, vertices, sf::RenderStates(transform));
+            return;
+        }
+
+        size_t count = shape.getPointCount();
+        if (count < 3) {
+            return;
+        }
+
+        BeginBatch(NULL, NULL, count * 9);
+
+        sf::Vector2f min_point = shape.getPoint(0);
+        sf::Vector2f max_point = min_point;
+        for (size_t i = 1; i < count; i++) {
+            sf::Vector2f point = shape.getPoint(i);
+            min_point = {std::min(min_point.x, point.x), std::min(min_point.y, point.y)};
+            max_point = {std::max(max_point.x, point.x), std::max(max_point.y, point.y)};
+        }
+        sf::Vector2f center((min_point.x + max_point.x) / 2, (min_point.y + max_point.y) / 2);
+        float outline = shape.getOutlineThickness();
+
+        sf::Color fill = shape.getFillColor();
+        if (fill.a != 0) {
+            sf::Vector2f center_pos = transform.transformPoint(center);
+            sf::Vector2f first = transform.transformPoint(shape.getPoint(0));
+            sf::Vector2f prev = first;
+            for (size_t i = 1; i <= count; i++) {
+                sf::Vector2f cur = (i == count) ? first : transform.transformPoint(shape.getPoint(i));
+                batch_.append(sf::Vertex(center_pos, fill));
+                batch_.append(sf::Vertex(prev, fill));
+                batch_.append(sf::Vertex(cur, fill));
+                prev = cur;
+            }
+        }
+
+        sf::Color border = shape.getOutlineColor();
+        if (outline == 0.f || border.a == 0) {
+            return;
+        }
+
+        sf::Vector2f inner_prev;
+        sf::Vector2f outer_prev;
+        sf::Vector2f inner_first;
+        sf::Vector2f outer_first;
+        for (size_t i = 0; i <= count; i++) {
+            size_t index = i % count;
+            sf::Vector2f p0 = shape.getPoint((index == 0) ? count - 1 : index - 1);
+            sf::Vector2f p1 = shape.getPoint(index);
+            sf::Vector2f p2 = shape.getPoint((index + 1) % count);
+
+            sf::Vector2f n1 = ShapeEdgeNormal(p0, p1);
+            sf::Vector2f n2 = ShapeEdgeNormal(p1, p2);
+            if (n1.x * (center.x - p1.x) + n1.y * (center.y - p1.y) > 0) {
+                n1 = {-n1.x, -n1.y};
+            }
+            if (n2.x * (center.x - p1.x) + n2.y * (center.y - p1.y) > 0) {
+                n2 = {-n2.x, -n2.y};
+            }
+
+            float factor = 1.f + (n1.x * n2.x + n1.y * n2.y);
+            sf::Vector2f normal((n1.x + n2.x) / factor, (n1.y + n2.y) / factor);
+
+            sf::Vector2f inner = transform.transformPoint(p1);
+            sf::Vector2f outer = transform.transformPoint({p1.x + normal.x * outline,
+                                                           p1.y + normal.y * outline});
+            if (i == 0) {
+                inner_first = inner;
+                outer_first = outer;
+            } else {
+                if (i == count) {
+                    inner = inner_first;
+                    outer = outer_first;
+                }
+                batch_.append(sf::Vertex(inner_prev, border));
+                batch_.append(sf::Vertex(outer_prev, border));
+                batch_.append(sf::Vertex(inner, border));
+                batch_.append(sf::Vertex(inner, border));
+                batch_.append(sf::Vertex(outer_prev, border));
+                batch_.append(sf::Vertex(outer, border));
+            }
+            inner_prev = inner;
+            outer_prev = outer;
+        }
+    }
+
+    void Texture::AppendVertices(const sf::Vertex* vertices, size_t count, const sf::Transform& transform,
+                                 const sf::Texture* texture, const sf::Shader* shader) {
+        if (count == 0) {
+            return;
+        }
+        if (count > kMaxBatchVertices) {
+            sf::RenderStates states(transform);
+            states.texture = texture;
+            states.shader = shader;
+            DrawDirect(vertices, count, sf::Triangles, states);
+            return;
+        }
+
+        BeginBatch(texture, shader, count);
+        for (size_t i = 0; i < count; i++) {
+            batch_.append(sf::Vertex(transform.transformPoint(vertices[i].position),
+                                     vertices[i].color, vertices[i].texCoords));
+        }
+    }
+
+    void Texture::BeginBatch(const sf::Texture* texture, const sf::Shader* shader, size_t count) {
+        if (texture != batch_texture_ || shader != batch_shader_
+            || batch_.getVertexCount() + count > kMaxBatchVertices) {
+            Flush();
+            batch_texture_ = texture;
+            batch_shader_ = shader;
+        }
+        dirty_ = true;
+    }
+
+    // The drawable doesn't tell its vertex count, the caller passes it for the stats
+    void Texture::DrawDirect(const sf::Drawable& drawable, size_t vertices, const sf::RenderStates& states) {
+        Flush();
+        target_->draw(drawable, states);
+        dirty_ = true;
+        RenderStats::Get().CountDrawCall(vertices);
+    }
 
-        return new Image(txtr.copyToImage());
+    void Texture::DrawDirect(const sf::Vertex* vertices, size_t count, sf::PrimitiveType type,
+                             const sf::RenderStates& states) {
+        Flush();
+        target_->draw(vertices, count, type, states);
+        dirty_ = true;
+        RenderStats::Get().CountDrawCall(count);
+    }
+
+    void Texture::Flush() {
+        if (batch_.getVertexCount() == 0) {
+            return;
+        }
+        sf::RenderStates states;
+        states.texture = batch_texture_;
+        states.shader = batch_shader_;
+        target_->draw(batch_, states);
+        RenderStats::Get().CountDrawCall(batch_.getVertexCount());
+        batch_.clear();
+    }
+
+    void Texture::Display() {
+        if (!dirty_) {
+            resolve_stats_.skipped++;
+            total_resolve_stats_.skipped++;
+            return;
+        }
+
+        TraceScope trace("Resolve");
+        Flush();
+        target_->display();
+        dirty_ = false;
+        RenderStats::Get().CountResolve();
+
+        resolve_stats_.resolves++;
+        total_resolve_stats_.resolves++;
     }
 
 //-----------------RENDER WINDOW------------------------------------------------------------------------------
 
+    bool IsOffscreenRequested() {
+        const char* value = getenv(kOffscreenEnvVar);
+        return value != NULL && strcmp(value, "") != 0 && strcmp(value, "0") != 0;
+    }
+
     RenderWindow::RenderWindow(size_t width, size_t height, const char* window_name)
-        :sf::RenderWindow(), title_(window_name) {
+        :sf::RenderWindow(), title_(window_name), offscreen_(IsOffscreenRequested()), offscreen_open_(false),
+         offscreen_target_(), frame_sink_(), frame_buffer_(), injected_events_(), frame_pacer_(),
+         redraw_on_demand_(false), redraw_needed_(true), stats_overlay_(false), next_text_buffer_(0),
+         event_mask_(kAllEventsMask), coalesce_events_(false), pending_event_(), last_mouse_pos_(), has_mouse_pos_(false),
+         input_thread_enabled_(false), input_thread_(), input_running_(false), input_ring_(), window_mutex_(),
+         input_wake_fds_{-1, -1}, display_(NULL), event_wake_fds_{-1, -1},
+         last_event_time_(0), recorder_(), replayer_(), input_latency_() {
         width_ = width;
         height_ = height;
         if (strcmp(window_name, "") != 0) {
@@ -497,47 +1076,415 @@ namespace graphics {
         default_font_ = NULL;
     }
 
-    RenderWindow::~RenderWindow() {}
+    RenderWindow::~RenderWindow() {
+        StopInputThread();
+        ReleaseFrameArena();
+#if defined(__linux__)
+        CloseWakePipe(input_wake_fds_);
+        CloseWakePipe(event_wake_fds_);
+#endif
+    }
 
     std::optional<dr4::Event> RenderWindow::PollEvent() {
-        static Coordinates old_coors(GetMousePos());
+        std::optional<dr4::Event> event = (replayer_ != NULL) ? PollReplay() : PollSource();
+        if (!event) {
+            return event;
+        }
+
+        if (recorder_ != NULL) {
+            recorder_->Write(*event, last_event_time_);
+        }
+        input_latency_.AddEvent(event->type, last_event_time_);
+        return event;
+    }
+
+    // Live events are drained while replaying, only QUIT gets through
+    std::optional<dr4::Event> RenderWindow::PollReplay() {
+        std::optional<dr4::Event> event;
+        while ((event = PollSource())) {
+            if (event->type == dr4::Event::Type::QUIT) {
+                return event;
+            }
+        }
+
+        // Latency counts from when the event was due, not from when the poll noticed it
+        double now = MonotonicSeconds();
+        double event_time = now;
+        while ((event = replayer_->Next(now, event_time))) {
+            if (IsSubscribed(event->type)) {
+                last_event_time_ = event_time;
+                redraw_needed_ = true;
+                return event;
+            }
+        }
+        return {};
+    }
+
+    // Injected events go ahead of system ones in every mode
+    std::optional<dr4::Event> RenderWindow::PollSource() {
+        std::optional<dr4::Event> injected = PopInjectedEvent();
+        if (injected || offscreen_) {
+            return injected;
+        }
+        if (input_thread_.joinable()) {
+            return PopCapturedEvent();
+        }
 
         sf::Event sf_event;
-        if (!(sf::RenderWindow::pollEvent(sf_event))) {
+        while (NextSystemEvent(sf_event)) {
+            if (!IsSubscribed(TranslateEventType(sf_event.type))) {
+                continue;
+            }
+
+            last_event_time_ = MonotonicSeconds();
+            dr4::Event event = TranslateEvent(sf_event);
+            if (coalesce_events_ && IsCoalescable(event.type)) {
+                CoalesceSystemEvents(sf_event, event);
+            }
+            return event;
+        }
+        return {};
+    }
+
+    // Events leave the system queue and get their time here, however long the frame is.
+    // Window state is shared with the rendering thread, so both sides hold window_mutex_.
+    // pollEvent applies resizes (size, view) under it too.
+    void RenderWindow::InputLoop() {
+        CapturedEvent captured = {};
+        bool has_captured = false;
+
+        while (input_running_.load(std::memory_order_acquire)) {
+            if (!has_captured) {
+                std::lock_guard<std::mutex> lock(window_mutex_);
+                sf::Event sf_event;
+                while (!has_captured && sf::RenderWindow::pollEvent(sf_event)) {
+                    if (!IsSubscribed(TranslateEventType(sf_event.type))) {
+                        continue;
+                    }
+                    captured.time = MonotonicSeconds();
+                    captured.event = TranslateEventInto(sf_event, captured.text);
+                    has_captured = true;
+                }
+            }
+
+            // A full ring keeps the event here and SFML keeps the rest, nothing is lost
+            if (has_captured && input_ring_->TryPush(captured)) {
+                has_captured = false;
+                WakeEventWaiter();
+                continue;
+            }
+            WaitInput(has_captured);
+        }
+    }
+
+    // Events Xlib has already read don't wake poll, those are polled for in short sleeps
+    void RenderWindow::WaitInput(bool ring_full) {
+#if defined(__linux__)
+        if (display_ != NULL && input_wake_fds_[0] >= 0 && !ring_full
+            && XEventsQueued(display_, kXQueuedAlready) == 0) {
+            pollfd fds[2] = {{XConnectionNumber(display_), POLLIN, 0}, {input_wake_fds_[0], POLLIN, 0}};
+            poll(fds, 2, kInputWaitLimitMs);
+            return;
+        }
+#endif
+        std::this_thread::sleep_for(kInputPollSlice);
+    }
+
+    void RenderWindow::StartInputThread() {
+        input_ring_ = std::make_unique<SpscRing<CapturedEvent>>(kInputRingCapacity);
+#if defined(__linux__)
+        OpenWakePipe(input_wake_fds_);
+#endif
+        input_running_.store(true, std::memory_order_release);
+        input_thread_ = std::thread(&RenderWindow::InputLoop, this);
+    }
+
+    void RenderWindow::StopInputThread() {
+        if (!input_thread_.joinable()) {
+            return;
+        }
+        input_running_.store(false, std::memory_order_release);
+#if defined(__linux__)
+        WakePipe(input_wake_fds_);
+#endif
+        input_thread_.join();
+        input_ring_.reset();
+#if defined(__linux__)
+        DrainWakePipe(input_wake_fds_);
+#endif
+    }
+
+    // Text is copied out of the ring slot, which the producer reuses after Pop()
+    std::optional<dr4::Event> RenderWindow::PopCapturedEvent() {
+        const CapturedEvent* captured = input_ring_->Front();
+        if (captured == NULL) {
             return {};
         }
 
-        dr4::Event event;
+        dr4::Event event = captured->event;
+        last_event_time_ = captured->time;
+        if (event.type == dr4::Event::Type::TEXT_EVENT) {
+            char* text = NextTextBuffer();
+            memcpy(text, captured->text, sizeof(captured->text));
+            event.text.unicode = text;
+        }
+        input_ring_->Pop();
+
+        if (coalesce_events_ && IsCoalescable(event.type)) {
+            while ((captured = input_ring_->Front()) != NULL && captured->event.type == event.type) {
+                MergeEvent(event, captured->event);
+                input_ring_->Pop();
+            }
+        }
+        return event;
+    }
+
+    void RenderWindow::StartRecording(const std::string& path) {
+        recorder_ = std::make_unique<EventRecorder>(path);
+    }
+
+    void RenderWindow::StopRecording() {
+        recorder_.reset();
+    }
+
+    void RenderWindow::StartReplay(const std::string& path, double speed) {
+        replayer_ = std::make_unique<EventReplayer>(path, speed, MonotonicSeconds());
+    }
+
+    void RenderWindow::StopReplay() {
+        replayer_.reset();
+    }
+
+    bool RenderWindow::IsReplaying() const {
+        return replayer_ != NULL && !replayer_->IsFinished();
+    }
+
+    void RenderWindow::SetInputThread(bool enabled) {
+        if (sf::RenderWindow::isOpen()) {
+            throw std::runtime_error("Input thread mode can't be changed for an open window");
+        }
+#if defined(__linux__)
+        // A no-op since libX11 1.8, which does it on load
+        if (enabled) {
+            XInitThreads();
+        }
+#endif
+        input_thread_enabled_ = enabled;
+    }
 
-        auto event_type_itr = kEventTypeTransformMap.find(sf_event.type);
-        if (event_type_itr == kEventTypeTransformMap.end()) {
-            event.type = dr4::Event::Type::UNKNOWN;
+    // The event read ahead by coalescing goes first
+    bool RenderWindow::NextSystemEvent(sf::Event& sf_event) {
+        if (pending_event_) {
+            sf_event = *pending_event_;
+            pending_event_.reset();
+            return true;
+        }
+        return sf::RenderWindow::pollEvent(sf_event);
+    }
+
+    // Merges the following events of the same kind into event, unsubscribed ones in between
+    // are dropped, the first different event is kept for the next PollEvent
+    void RenderWindow::CoalesceSystemEvents(const sf::Event& first, dr4::Event& event) {
+        sf::Event next;
+        while (NextSystemEvent(next)) {
+            dr4::Event::Type type = TranslateEventType(next.type);
+            if (!IsSubscribed(type)) {
+                continue;
+            }
+            if (type != event.type || (type == dr4::Event::Type::MOUSE_WHEEL
+                                       && next.mouseWheelScroll.wheel != first.mouseWheelScroll.wheel)) {
+                pending_event_ = next;
+                return;
+            }
+            MergeEvent(event, TranslateEvent(next));
+        }
+    }
+
+    bool RenderWindow::IsCoalescable(dr4::Event::Type type) {
+        return type == dr4::Event::Type::MOUSE_MOVE || type == dr4::Event::Type::MOUSE_WHEEL;
+    }
+
+    // Position of the later event, motion of both
+    void RenderWindow::MergeEvent(dr4::Event& event, const dr4::Event& next) {
+        if (event.type == dr4::Event::Type::MOUSE_MOVE) {
+            event.mouseMove.pos = next.mouseMove.pos;
+            event.mouseMove.rel.x += next.mouseMove.rel.x;
+            event.mouseMove.rel.y += next.mouseMove.rel.y;
+        } else {
+            event.mouseWheel.pos = next.mouseWheel.pos;
+            event.mouseWheel.delta.x += next.mouseWheel.delta.x;
+            event.mouseWheel.delta.y += next.mouseWheel.delta.y;
+        }
+    }
+
+    bool RenderWindow::IsSubscribed(dr4::Event::Type type) const {
+        return (event_mask_.load(std::memory_order_relaxed) & EventMaskOf(type)) != 0;
+    }
+
+    // Stops before the text buffers wrap, so every returned text pointer is still valid
+    size_t RenderWindow::PollEvents(dr4::Event* events, size_t capacity) {
+        size_t count = 0;
+        size_t texts = 0;
+        while (count < capacity && texts < kTextBufferCount) {
+            std::optional<dr4::Event> event = PollEvent();
+            if (!event) {
+                break;
+            }
+            if (event->type == dr4::Event::Type::TEXT_EVENT) {
+                texts++;
+            }
+            events[count++] = *event;
+        }
+        return count;
+    }
+
+    // SFML 2 can only block without a timeout, so timed waits poll in short sleeps
+    std::optional<dr4::Event> RenderWindow::WaitEvent(double timeout) {
+        MonotonicClock::time_point deadline = (timeout < 0) ? MonotonicClock::time_point::max()
+            : MonotonicClock::now()
+              + std::chrono::duration_cast<MonotonicClock::duration>(std::chrono::duration<double>(timeout));
+
+        // Injected events may all be filtered out, then the wait goes on
+        if (offscreen_ && replayer_ == NULL) {
+            std::unique_lock<std::mutex> lock(injected_mutex_);
+            auto is_woken = [this] {return !injected_events_.empty() || (redraw_on_demand_ && redraw_needed_);};
+            while (true) {
+                if (timeout < 0) {
+                    injected_cond_.wait(lock, is_woken);
+                } else if (!injected_cond_.wait_until(lock, deadline, is_woken)) {
+                    return {};
+                }
+                if (injected_events_.empty()) {
+                    return {};
+                }
+
+                lock.unlock();
+                std::optional<dr4::Event> event = PollEvent();
+                if (event) {
+                    return event;
+                }
+                lock.lock();
+            }
+        }
+
+        while (true) {
+            std::optional<dr4::Event> event = PollEvent();
+            if (event) {
+                return event;
+            }
+
+            if (MonotonicClock::now() >= deadline || !IsOpen() || (redraw_on_demand_ && redraw_needed_)) {
+                return {};
+            }
+            SleepUntilEvent(deadline);
+        }
+    }
+
+    // Sleeps on the wake pipe and the X connection, or only the pipe when the input thread
+    // reads the connection. Events Xlib has already read don't wake poll, so with those,
+    // during replays and without the connection it sleeps kWaitEventSlice.
+    void RenderWindow::SleepUntilEvent(MonotonicClock::time_point deadline) {
+#if defined(__linux__)
+        bool threaded = input_thread_.joinable();
+        if (replayer_ == NULL && event_wake_fds_[0] >= 0
+            && (threaded || (display_ != NULL && XEventsQueued(display_, kXQueuedAlready) == 0))) {
+            int timeout_ms = -1;
+            if (deadline != MonotonicClock::time_point::max()) {
+                auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - MonotonicClock::now());
+                timeout_ms = (int)std::clamp<std::chrono::milliseconds::rep>(remaining.count(), 0, INT_MAX);
+            }
+
+            pollfd fds[2] = {{event_wake_fds_[0], POLLIN, 0},
+                             {threaded ? -1 : XConnectionNumber(display_), POLLIN, 0}};
+            poll(fds, 2, timeout_ms);
+            DrainWakePipe(event_wake_fds_);
+            return;
+        }
+#endif
+        MonotonicClock::duration remaining = deadline - MonotonicClock::now();
+        std::this_thread::sleep_for(std::min<MonotonicClock::duration>(kWaitEventSlice, remaining));
+    }
+
+    void RenderWindow::WakeEventWaiter() {
+#if defined(__linux__)
+        WakePipe(event_wake_fds_);
+#endif
+    }
+
+    // Injected events are filtered and coalesced like system ones
+    std::optional<dr4::Event> RenderWindow::PopInjectedEvent() {
+        std::lock_guard<std::mutex> lock(injected_mutex_);
+        while (!injected_events_.empty()) {
+            dr4::Event event = injected_events_.front().event;
+            last_event_time_ = injected_events_.front().time;
+            injected_events_.pop_front();
+            if (!IsSubscribed(event.type)) {
+                continue;
+            }
+            redraw_needed_ = true;
+
+            if (coalesce_events_ && IsCoalescable(event.type)) {
+                while (!injected_events_.empty()) {
+                    const dr4::Event& next = injected_events_.front().event;
+                    if (!IsSubscribed(next.type)) {
+                        injected_events_.pop_front();
+                        continue;
+                    }
+                    if (next.type != event.type) {
+                        break;
+                    }
+                    MergeEvent(event, next);
+                    injected_events_.pop_front();
+                }
+            }
             return event;
         }
+        return {};
+    }
+
+    // Every delivered system event (input, resize, focus change) means the picture may be stale,
+    // filtered ones are dropped before translation
+    dr4::Event RenderWindow::TranslateEvent(const sf::Event& sf_event) {
+        return TranslateEventInto(sf_event, NULL);
+    }
 
-        event.type = event_type_itr->second;
+    char* RenderWindow::NextTextBuffer() {
+        char* text = text_buffers_[next_text_buffer_];
+        next_text_buffer_ = (next_text_buffer_ + 1) % kTextBufferCount;
+        return text;
+    }
+
+    // TEXT_EVENT string goes to text, or to the next rotating buffer if it's NULL
+    dr4::Event RenderWindow::TranslateEventInto(const sf::Event& sf_event, char* text) {
+        redraw_needed_ = true;
+
+        dr4::Event event;
+
+        event.type = TranslateEventType(sf_event.type);
 
         switch (event.type) {
             case dr4::Event::Type::QUIT : {
                 break;
             }
             case dr4::Event::Type::MOUSE_DOWN : case dr4::Event::Type::MOUSE_UP : {
-                auto mouse_button_itr = kMouseButtonTransformMap.find(sf_event.mouseButton.button);
-                if (mouse_button_itr == kMouseButtonTransformMap.end()) {
-                    event.mouseButton.button = dr4::MouseButtonType::UNKNOWN;
+                event.mouseButton.button = TranslateMouseButton(sf_event.mouseButton.button);
+                if (event.mouseButton.button == dr4::MouseButtonType::UNKNOWN) {
                     return event;
                 }
 
-                event.mouseButton.button = mouse_button_itr->second;
-                Coordinates pos(GetMousePos());
-                event.mouseButton.pos = {pos[0], pos[1]};
+                event.mouseButton.pos = MapEventPos(sf_event.mouseButton.x, sf_event.mouseButton.y);
                 break;
             }
             case dr4::Event::Type::MOUSE_MOVE : {
-                Coordinates pos(GetMousePos());
-                event.mouseMove.pos = {pos[0], pos[1]};
-                event.mouseMove.rel = {pos[0] - old_coors[0], pos[1] - old_coors[1]};
-                old_coors = pos;
+                dr4::Vec2f pos = MapEventPos(sf_event.mouseMove.x, sf_event.mouseMove.y);
+                event.mouseMove.pos = pos;
+                // The first move has nothing to be relative to
+                if (!has_mouse_pos_) {
+                    last_mouse_pos_ = pos;
+                    has_mouse_pos_ = true;
+                }
+                event.mouseMove.rel = {pos.x - last_mouse_pos_.x, pos.y - last_mouse_pos_.y};
+                last_mouse_pos_ = pos;
                 break;
             }
             case dr4::Event::Type::MOUSE_WHEEL : {
@@ -548,8 +1495,7 @@ namespace graphics {
                     event.mouseWheel.delta.x = 0;
                     event.mouseWheel.delta.y = sf_event.mouseWheelScroll.delta;
                 }
-                Coordinates pos(GetMousePos());
-                event.mouseWheel.pos = {pos[0], pos[1]};
+                event.mouseWheel.pos = MapEventPos(sf_event.mouseWheelScroll.x, sf_event.mouseWheelScroll.y);
                 break;
             }
             case dr4::Event::Type::KEY_DOWN :  case dr4::Event::Type::KEY_UP : {
@@ -557,19 +1503,16 @@ namespace graphics {
                                | ((sf_event.key.alt)    ? dr4::KeyMode::KEYMOD_ALT   : 1)
                                | ((sf_event.key.shift)  ? dr4::KeyMode::KEYMOD_SHIFT : 1);
 
-                auto key_itr = kKeyCodeTransformMap.find(sf_event.key.scancode);
-                if (key_itr == kKeyCodeTransformMap.end()) {
-                    event.key.sym = dr4::KeyCode::KEYCODE_UNKNOWN;
-                    return event;
-                }
-
-                event.key.sym = key_itr->second;
+                event.key.sym = TranslateKeyCode(sf_event.key.scancode);
                 break;
             }
             case dr4::Event::Type::TEXT_EVENT : {
-                memmove(buffer, &(sf_event.text.unicode), sizeof(sf_event.text.unicode));
-                buffer[sizeof(sf_event.text.unicode)] = '\0';
-                event.text.unicode = buffer;
+                if (text == NULL) {
+                    text = NextTextBuffer();
+                }
+                memmove(text, &(sf_event.text.unicode), sizeof(sf_event.text.unicode));
+                text[sizeof(sf_event.text.unicode)] = '\0';
+                event.text.unicode = text;
                 break;
             }
             default : {
@@ -594,13 +1537,21 @@ namespace graphics {
     }
 
     void RenderWindow::SetSize(dr4::Vec2f size) {
+        std::lock_guard<std::mutex> lock(window_mutex_);
         width_ = size.x;
         height_ = size.y;
+        if (offscreen_) {
+            if (offscreen_open_) {
+                CreateOffscreenTarget();
+            }
+            return;
+        }
         sf::RenderWindow::setSize({(unsigned int)width_, (unsigned int)height_});
         sf::RenderWindow::setView(sf::View({width_ / 2, height_ / 2}, {width_, height_}));
     }
 
     void RenderWindow::SetTitle(const std::string &title) {
+        std::lock_guard<std::mutex> lock(window_mutex_);
         sf::RenderWindow::setTitle(title);
         title_ = title;
     }
@@ -631,7 +1582,58 @@ namespace graphics {
         return new Text();
     }
 
+    dr4::Line *RenderWindow::CreateTransientLine() {
+        Line* line = new Line();
+        frame_arena_.push_back(line);
+        return line;
+    }
+    dr4::Circle *RenderWindow::CreateTransientCircle() {
+        Circle* circle = new Circle();
+        frame_arena_.push_back(circle);
+        return circle;
+    }
+    dr4::Rectangle *RenderWindow::CreateTransientRectangle() {
+        RectangleShape* rectangle = new RectangleShape();
+        frame_arena_.push_back(rectangle);
+        return rectangle;
+    }
+    dr4::Text *RenderWindow::CreateTransientText() {
+        Text* text = new Text();
+        frame_arena_.push_back(text);
+        return text;
+    }
+
+    void RenderWindow::ReleaseFrameArena() {
+        for (dr4::Drawable* drawable : frame_arena_) {
+            delete drawable;
+        }
+        frame_arena_.clear();
+    }
+
+    PrimitiveAllocStats RenderWindow::GetAllocStats() const {
+        return {Line::GetSlabStats(), Circle::GetSlabStats(), RectangleShape::GetSlabStats(),
+                Text::GetSlabStats(), frame_arena_.size()};
+    }
+
+    // Same scaling as GetMousePos, without asking the system for the pointer position
+    dr4::Vec2f RenderWindow::MapEventPos(int x, int y) const {
+        sf::Vector2u size = sf::RenderWindow::getSize();
+        if (size.x == 0 || size.y == 0) {
+            return {(float)x, (float)y};
+        }
+        return {(float)x * width_ / size.x, (float)y * height_ / size.y};
+    }
+
+    void RenderWindow::SetEventMask(uint32_t mask) {
+        event_mask_.store(mask, std::memory_order_relaxed);
+    }
+
+    void RenderWindow::SetEventCoalescing(bool enabled) {
+        coalesce_events_ = enabled;
+    }
+
     Coordinates RenderWindow::GetMousePos() const {
+        std::lock_guard<std::mutex> lock(window_mutex_);
         float scale_x = sf::RenderWindow::getSize().x / width_;
         float scale_y = sf::RenderWindow::getSize().y / height_;
         return Coordinates(2, (float)sf::Mouse::getPosition(*this).x / scale_x,
@@ -639,39 +1641,182 @@ namespace graphics {
     }
 
     void RenderWindow::Draw(const dr4::Texture &texture) {
-        (const_cast<Texture&>(dynamic_cast<const Texture&>(texture))).display();
+        Texture& my_texture = const_cast<Texture&>(dynamic_cast<const Texture&>(texture));
+        my_texture.Display();
 
-        sf::Sprite sprite(dynamic_cast<const Texture&>(texture).getTexture());
+        sf::Sprite sprite(my_texture.GetSfTexture(), my_texture.GetTextureRect());
         sprite.setPosition({0, 0});
-        sf::RenderWindow::draw(sprite);
+        std::lock_guard<std::mutex> lock(window_mutex_);
+        GetTarget().draw(sprite);
+        RenderStats::Get().CountDrawCall(kSpriteVertexCount);
+    }
+
+    sf::RenderTarget& RenderWindow::GetTarget() {
+        if (offscreen_target_ != NULL) {
+            return *offscreen_target_;
+        }
+        return *this;
+    }
+
+    void RenderWindow::CreateOffscreenTarget() {
+        unsigned width = (width_ > 1) ? width_ : 1;
+        unsigned height = (height_ > 1) ? height_ : 1;
+
+        if (offscreen_target_ == NULL) {
+            offscreen_target_ = std::make_unique<sf::RenderTexture>();
+        }
+        if (!offscreen_target_->create(width, height)) {
+            throw std::runtime_error("Can't create offscreen render texture");
+        }
     }
 
     void RenderWindow::Open() {
+        if (offscreen_) {
+            CreateOffscreenTarget();
+            offscreen_open_ = true;
+            return;
+        }
         sf::RenderWindow::create(sf::VideoMode(width_, height_), title_);
+#if defined(__linux__)
+        // The current context is the window's after create()
+        display_ = (sf::RenderWindow::setActive(true)) ? glXGetCurrentDisplay() : NULL;
+        OpenWakePipe(event_wake_fds_);
+#endif
+        if (input_thread_enabled_) {
+            StartInputThread();
+        }
     }
 
+    // Offscreen frames aren't throttled by vsync, the sink is called synchronously
     void RenderWindow::Display() {
-        sf::RenderWindow::display();
+        uint64_t start = MonotonicNanoseconds();
+        if (offscreen_target_ != NULL) {
+            if (stats_overlay_) {
+                DrawStatsOverlay();
+            }
+            offscreen_target_->display();
+            if (frame_sink_) {
+                sf::Vector2u size = offscreen_target_->getSize();
+                frame_buffer_.resize((size_t)size.x * size.y * 4);
+                graphics::ReadPixels(*offscreen_target_, size, sf::IntRect(0, 0, size.x, size.y), frame_buffer_.data());
+                RenderStats::Get().CountReadback(frame_buffer_.size());
+                frame_sink_(frame_buffer_.data(), size.x, size.y);
+            }
+        } else {
+            // The swap may block for a vsync interval, the input thread mustn't wait for it
+            if (stats_overlay_) {
+                std::lock_guard<std::mutex> lock(window_mutex_);
+                DrawStatsOverlay();
+            }
+            sf::RenderWindow::display();
+        }
+        input_latency_.OnDisplay(MonotonicSeconds());
+        ReleaseFrameArena();
+        redraw_needed_ = false;
+
+        uint64_t end = MonotonicNanoseconds();
+        RenderStats::Get().AddTraceEvent("Display", start, end);
+        RenderStats::Get().EndFrame((end - start) * 1e-9);
+
+        frame_pacer_.WaitNextFrame();
+    }
+
+    // Stats of the previous frame: this one isn't finished yet
+    void RenderWindow::DrawStatsOverlay() {
+        if (default_font_ == NULL) {
+            return;
+        }
+
+        const FrameStats& stats = RenderStats::Get().GetLastFrame();
+        const LatencyHistogram& latency = input_latency_.GetHistogram();
+        char line[kStatsOverlayLength] = "";
+        snprintf(line, sizeof(line),
+                 "%.2f ms (display %.2f ms)\ndraws %zu  vertices %zu\nuploads %zu  resolves %zu  readbacks %zu\n"
+                 "input latency p50 %.1f ms  p99 %.1f ms",
+                 stats.frame_time * 1e3, stats.display_time * 1e3, stats.draw_calls, stats.vertices,
+                 stats.uploads, stats.resolves, stats.readbacks,
+                 latency.GetPercentile(0.5) * 1e3, latency.GetPercentile(0.99) * 1e3);
+
+        sf::RenderTarget& target = GetTarget();
+        sf::View view = target.getView();
+        target.setView(target.getDefaultView());
+
+        sf::Text text(line, *default_font_, kStatsOverlayFontSize);
+        text.setPosition({kStatsOverlayPadding, kStatsOverlayPadding});
+        text.setFillColor(sf::Color::White);
+
+        sf::FloatRect bounds = text.getGlobalBounds();
+        sf::RectangleShape background({bounds.left + bounds.width + kStatsOverlayPadding,
+                                       bounds.top + bounds.height + kStatsOverlayPadding});
+        background.setFillColor(sf::Color(0, 0, 0, 160));
+
+        target.draw(background);
+        target.draw(text);
+        target.setView(view);
     }
 
     bool RenderWindow::IsOpen() const {
+        if (offscreen_) {
+            return offscreen_open_;
+        }
         return sf::RenderWindow::isOpen();
     }
 
     void RenderWindow::Close() {
+        if (offscreen_) {
+            offscreen_open_ = false;
+            offscreen_target_.reset();
+            return;
+        }
+        StopInputThread();
         sf::RenderWindow::close();
     }
 
     void RenderWindow::Clear(dr4::Color color) {
-        sf::RenderWindow::clear(sf::Color(color.r, color.g, color.b, color.a));
+        std::lock_guard<std::mutex> lock(window_mutex_);
+        GetTarget().clear(sf::Color(color.r, color.g, color.b, color.a));
     }
 
     double RenderWindow::GetTime() {
-        return time(NULL);
+        return MonotonicSeconds();
     }
 
     void RenderWindow::Sleep(double time) {
-        sleep(time);
+        PreciseSleep(time);
+    }
+
+    const FrameStats& RenderWindow::GetFrameStats() const {
+        return RenderStats::Get().GetLastFrame();
+    }
+
+    void RenderWindow::SetStatsOverlay(bool enabled) {
+        stats_overlay_ = enabled;
+    }
+
+    void RenderWindow::StartTrace() {
+        RenderStats::Get().StartTrace();
+    }
+
+    void RenderWindow::WriteTrace(const std::string& path) {
+        RenderStats::Get().StopTrace();
+        RenderStats::Get().WriteTrace(path);
+    }
+
+    void RenderWindow::ResetInputLatency() {
+        input_latency_.Reset();
+    }
+
+    void RenderWindow::SetLatencySamples(bool enabled) {
+        input_latency_.SetKeepSamples(enabled);
+    }
+
+    void RenderWindow::WriteLatencySamples(const std::string& path) const {
+        input_latency_.WriteSamples(path);
+    }
+
+    void RenderWindow::SetFrameRateLimit(double frames_per_second) {
+        frame_pacer_.SetPeriod((frames_per_second > 0) ? 1 / frames_per_second : 0);
+        frame_pacer_.ResetStats();
     }
 
     void RenderWindow::StartTextInput() {
@@ -695,6 +1840,47 @@ namespace graphics {
         return clip_board_.getString();
     }
 
+    void RenderWindow::SetOffscreen(bool offscreen) {
+        if (offscreen_open_ || sf::RenderWindow::isOpen()) {
+            throw std::runtime_error("Offscreen mode can't be changed for an open window");
+        }
+        offscreen_ = offscreen;
+    }
+
+    void RenderWindow::SetFrameSink(FrameSink sink) {
+        frame_sink_ = std::move(sink);
+    }
+
+    void RenderWindow::PushEvent(const dr4::Event& event) {
+        {
+            std::lock_guard<std::mutex> lock(injected_mutex_);
+            CapturedEvent captured = {};
+            captured.event = event;
+            captured.time = MonotonicSeconds();
+            injected_events_.push_back(captured);
+        }
+        injected_cond_.notify_one();
+        WakeEventWaiter();
+    }
+
+    void RenderWindow::SetRedrawOnDemand(bool on_demand) {
+        redraw_on_demand_ = on_demand;
+        redraw_needed_ = true;
+    }
+
+    bool RenderWindow::NeedsRedraw() const {
+        return !redraw_on_demand_ || redraw_needed_;
+    }
+
+    void RenderWindow::RequestRedraw() {
+        {
+            std::lock_guard<std::mutex> lock(injected_mutex_);
+            redraw_needed_ = true;
+        }
+        injected_cond_.notify_one();
+        WakeEventWaiter();
+    }
+
 //------------------------------------------------------------------------------------------------------------
 
 }
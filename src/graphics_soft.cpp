@@ -0,0 +1,919 @@
+#include "../include/graphics_soft.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <stdexcept>
+#include <algorithm>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "../include/frame_pacer.hpp"
+
+namespace graphics {
+namespace soft {
+
+    static const float kCircleSegmentLength = 2.f;
+    static const unsigned kCircleMinPoints = 8;
+    static const unsigned kCircleMaxPoints = 512;
+
+    // Invalid sequences are skipped byte by byte
+    static void DecodeUtf8(const std::string& text, std::vector<uint32_t>& codepoints) {
+        codepoints.clear();
+        size_t i = 0;
+        while (i < text.size()) {
+            uint8_t lead = text[i];
+            size_t length = (lead < 0x80) ? 1 : ((lead >> 5) == 0x6) ? 2 : ((lead >> 4) == 0xE) ? 3
+                          : ((lead >> 3) == 0x1E) ? 4 : 0;
+            if (length == 0 || i + length > text.size()) {
+                i++;
+                continue;
+            }
+
+            uint32_t codepoint = (length == 1) ? lead : lead & (0x7F >> length);
+            for (size_t j = 1; j < length; j++) {
+                codepoint = (codepoint << 6) | (text[i + j] & 0x3F);
+            }
+            codepoints.push_back(codepoint);
+            i += length;
+        }
+    }
+
+//-----------------FONT---------------------------------------------------------------------------------------
+
+    Font::Font()
+        :library_(NULL), face_(NULL), buffer_(), generation_(0), current_size_(0), glyphs_() {
+        if (FT_Init_FreeType(&library_) != 0) {
+            throw std::runtime_error("Can't initialize FreeType");
+        }
+    }
+
+    Font::~Font() {
+        Reset();
+        FT_Done_FreeType(library_);
+    }
+
+    void Font::Reset() {
+        if (face_ != NULL) {
+            FT_Done_Face(face_);
+            face_ = NULL;
+        }
+        glyphs_.clear();
+        buffer_.clear();
+        current_size_ = 0;
+    }
+
+    void Font::LoadFromFile(const std::string& path) {
+        generation_++;
+        Reset();
+        if (FT_New_Face(library_, path.c_str(), 0, &face_) != 0) {
+            face_ = NULL;
+            throw std::runtime_error("No files for font uploading");
+        }
+        FT_Select_Charmap(face_, FT_ENCODING_UNICODE);
+    }
+    void Font::LoadFromBuffer(const void* buffer, size_t size) {
+        generation_++;
+        Reset();
+        buffer_.assign((const uint8_t*)buffer, (const uint8_t*)buffer + size);
+        if (FT_New_Memory_Face(library_, buffer_.data(), buffer_.size(), 0, &face_) != 0) {
+            face_ = NULL;
+            throw std::runtime_error("No files for font uploading");
+        }
+        FT_Select_Charmap(face_, FT_ENCODING_UNICODE);
+    }
+
+    void Font::SetCurrentSize(unsigned size) const {
+        if (size != current_size_) {
+            FT_Set_Pixel_Sizes(face_, 0, size);
+            current_size_ = size;
+        }
+    }
+
+    // Metrics are computed the same way as sf::Font does
+    float Font::GetLineSpacing(unsigned size) const {
+        if (face_ == NULL) {
+            return 0;
+        }
+        SetCurrentSize(size);
+        return face_->size->metrics.height / 64.f;
+    }
+    float Font::GetUnderlinePosition(unsigned size) const {
+        if (face_ == NULL) {
+            return 0;
+        }
+        SetCurrentSize(size);
+        if (!FT_IS_SCALABLE(face_)) {
+            return size / 10.f;
+        }
+        return -FT_MulFix(face_->underline_position, face_->size->metrics.y_scale) / 64.f;
+    }
+    float Font::GetKerning(uint32_t first, uint32_t second, unsigned size) const {
+        if (face_ == NULL || first == 0 || second == 0 || !FT_HAS_KERNING(face_)) {
+            return 0;
+        }
+        SetCurrentSize(size);
+
+        FT_Vector kerning;
+        FT_Get_Kerning(face_, FT_Get_Char_Index(face_, first), FT_Get_Char_Index(face_, second),
+                       FT_KERNING_UNFITTED, &kerning);
+        return kerning.x / 64.f;
+    }
+
+    float Font::GetAscent(float fontSize) const {
+        return GetLineSpacing(fontSize) - GetUnderlinePosition(fontSize);
+    }
+    float Font::GetDescent(float fontSize) const {
+        return GetUnderlinePosition(fontSize);
+    }
+
+    const GlyphBitmap& Font::GetGlyph(uint32_t codepoint, unsigned size) const {
+        uint64_t key = ((uint64_t)size << 32) | codepoint;
+        auto itr = glyphs_.find(key);
+        if (itr != glyphs_.end()) {
+            return itr->second;
+        }
+
+        GlyphBitmap glyph = {0, 0, 0, 0, 0, {}};
+        if (face_ != NULL) {
+            SetCurrentSize(size);
+        }
+        if (face_ != NULL
+            && FT_Load_Char(face_, codepoint, FT_LOAD_TARGET_NORMAL | FT_LOAD_FORCE_AUTOHINT | FT_LOAD_RENDER) == 0) {
+            FT_GlyphSlot slot = face_->glyph;
+            const FT_Bitmap& bitmap = slot->bitmap;
+
+            glyph.advance = slot->advance.x >> 6;
+            glyph.left = slot->bitmap_left;
+            glyph.top = -slot->bitmap_top;
+            glyph.width = bitmap.width;
+            glyph.height = bitmap.rows;
+            glyph.coverage.resize((size_t)glyph.width * glyph.height);
+
+            for (unsigned y = 0; y < glyph.height; y++) {
+                const uint8_t* row = bitmap.buffer + (ptrdiff_t)y * bitmap.pitch;
+                uint8_t* dst = glyph.coverage.data() + (size_t)y * glyph.width;
+                if (bitmap.pixel_mode == FT_PIXEL_MODE_MONO) {
+                    for (unsigned x = 0; x < glyph.width; x++) {
+                        dst[x] = (row[x / 8] & (0x80 >> (x % 8))) ? 255 : 0;
+                    }
+                } else {
+                    memcpy(dst, row, glyph.width);
+                }
+            }
+        }
+
+        return glyphs_.emplace(key, std::move(glyph)).first->second;
+    }
+
+//-----------------TEXT---------------------------------------------------------------------------------------
+
+    Text::Text()
+        :font_(NULL), valign_(dr4::Text::VAlign::TOP), text_(""), color_(255, 255, 255), size_(30),
+         pos_({0, 0}), glyphs_(), bounds_width_(0), bounds_height_(0), layout_valid_(false),
+         font_generation_(0) {}
+
+    void Text::SetText(const std::string& new_text) {
+        if (new_text == text_) {
+            return;
+        }
+        text_ = new_text;
+        layout_valid_ = false;
+    }
+    void Text::SetColor(dr4::Color color) {
+        color_ = color;
+    }
+    void Text::SetFontSize(float size) {
+        size_ = size;
+        layout_valid_ = false;
+    }
+    void Text::SetVAlign(dr4::Text::VAlign valign) {
+        valign_ = valign;
+    }
+    void Text::SetFont(const dr4::Font* font) {
+        font_ = dynamic_cast<const Font*>(font);
+        layout_valid_ = false;
+    }
+
+    dr4::Vec2f Text::GetBounds() const {
+        UpdateLayout();
+        return {bounds_width_, bounds_height_};
+    }
+    const std::string& Text::GetText() const {
+        return text_;
+    }
+    dr4::Color Text::GetColor() const {
+        return color_;
+    }
+    float Text::GetFontSize() const {
+        return size_;
+    }
+    dr4::Text::VAlign Text::GetVAlign() const {
+        return valign_;
+    }
+    const dr4::Font *Text::GetFont() const {
+        return font_;
+    }
+
+    void Text::SetPos(dr4::Vec2f pos) {
+        pos_ = pos;
+    }
+    dr4::Vec2f Text::GetPos() const {
+        return pos_;
+    }
+
+    void Text::DrawOn(dr4::Texture& texture) const {
+        if (font_ == NULL) {
+            return;
+        }
+
+        UpdateLayout();
+        auto& my_texture = dynamic_cast<Texture&>(texture);
+
+        dr4::Vec2f origin = GetOrigin();
+        for (const PlacedGlyph& placed : glyphs_) {
+            my_texture.BlitMask(*placed.glyph, origin.x + placed.x, origin.y + placed.y, color_);
+        }
+    }
+
+    // Same pen movement and bounds as the SFML backend's glyph layout
+    void Text::UpdateLayout() const {
+        if (font_ != NULL && font_->GetGeneration() != font_generation_) {
+            font_generation_ = font_->GetGeneration();
+            layout_valid_ = false;
+        }
+        if (layout_valid_) {
+            return;
+        }
+
+        glyphs_.clear();
+        bounds_width_ = 0;
+        bounds_height_ = 0;
+        layout_valid_ = true;
+        if (font_ == NULL || !font_->IsLoaded()) {
+            return;
+        }
+
+        thread_local std::vector<uint32_t> codepoints;
+        DecodeUtf8(text_, codepoints);
+
+        float whitespace = font_->GetGlyph(L' ', size_).advance;
+        float line_spacing = font_->GetLineSpacing(size_);
+
+        float x = 0;
+        float y = size_;
+        float min_x = size_;
+        float min_y = size_;
+        float max_x = 0;
+        float max_y = 0;
+        uint32_t prev = 0;
+
+        for (uint32_t codepoint : codepoints) {
+            if (codepoint == L'\r') {
+                continue;
+            }
+
+            x += font_->GetKerning(prev, codepoint, size_);
+            prev = codepoint;
+
+            if (codepoint == L' ' || codepoint == L'\t' || codepoint == L'\n') {
+                min_x = std::min(min_x, x);
+                min_y = std::min(min_y, y);
+                if (codepoint == L' ') {
+                    x += whitespace;
+                } else if (codepoint == L'\t') {
+                    x += whitespace * 4;
+                } else {
+                    y += line_spacing;
+                    x = 0;
+                }
+                max_x = std::max(max_x, x);
+                max_y = std::max(max_y, y);
+                continue;
+            }
+
+            const GlyphBitmap& glyph = font_->GetGlyph(codepoint, size_);
+
+            float left = x + glyph.left;
+            float top = y + glyph.top;
+            if (glyph.width > 0 && glyph.height > 0) {
+                glyphs_.push_back({&glyph, left, top});
+            }
+
+            min_x = std::min(min_x, left);
+            max_x = std::max(max_x, left + glyph.width);
+            min_y = std::min(min_y, top);
+            max_y = std::max(max_y, top + glyph.height);
+
+            x += glyph.advance;
+        }
+
+        if (max_x >= min_x && max_y >= min_y) {
+            bounds_width_ = max_x - min_x;
+            bounds_height_ = max_y - min_y;
+        }
+    }
+
+    dr4::Vec2f Text::GetOrigin() const {
+        switch(valign_) {
+            case dr4::Text::VAlign::BASELINE : {
+                return {pos_.x, pos_.y - bounds_height_ + font_->GetUnderlinePosition(size_)};
+            }
+            case dr4::Text::VAlign::BOTTOM : {
+                return {pos_.x, pos_.y - bounds_height_};
+            }
+            case dr4::Text::VAlign::MIDDLE : {
+                return {pos_.x, pos_.y - bounds_height_ / 2};
+            }
+            default:
+                return pos_;
+        }
+    }
+
+//-----------------LINE---------------------------------------------------------------------------------------
+
+    Line::Line()
+        :start_({0, 0}), end_({0, 0}), color_(255, 255, 255), thickness_(0) {}
+
+    void Line::SetStart(dr4::Vec2f start) {
+        start_ = start;
+    }
+    void Line::SetEnd(dr4::Vec2f end) {
+        end_ = end;
+    }
+    void Line::SetColor(dr4::Color color) {
+        color_ = color;
+    }
+    void Line::SetThickness(float thickness) {
+        thickness_ = thickness;
+    }
+
+    dr4::Vec2f Line::GetStart() const {
+        return start_;
+    }
+    dr4::Vec2f Line::GetEnd() const {
+        return end_;
+    }
+    dr4::Color Line::GetColor() const {
+        return color_;
+    }
+    float Line::GetThickness() const {
+        return thickness_;
+    }
+
+    // Rectangle from start to end, thickness grows to the left of the direction
+    // like the rotated sf::RectangleShape of the SFML backend
+    void Line::DrawOn(dr4::Texture& texture) const {
+        dr4::Vec2f delta = end_ - start_;
+        float len = sqrtf(delta.x * delta.x + delta.y * delta.y);
+        if (len == 0 || thickness_ == 0) {
+            return;
+        }
+
+        dr4::Vec2f normal = dr4::Vec2f(-delta.y, delta.x) * (thickness_ / len);
+        Contour contour = {{{start_.x, start_.y}, {end_.x, end_.y},
+                            {end_.x + normal.x, end_.y + normal.y}, {start_.x + normal.x, start_.y + normal.y}}};
+        dynamic_cast<Texture&>(texture).FillPath(&contour, 1, color_);
+    }
+
+    void Line::SetPos(dr4::Vec2f pos) {
+        SetStart(pos);
+    }
+    dr4::Vec2f Line::GetPos() const {
+        return GetStart();
+    }
+
+//-----------------CIRCLE-------------------------------------------------------------------------------------
+
+    static void BuildEllipse(Contour& contour, dr4::Vec2f center, float radius_x, float radius_y,
+                             unsigned count, bool reverse) {
+        contour.points.resize(count);
+        for (unsigned i = 0; i < count; i++) {
+            float angle = 2.f * (float)M_PI * i / count;
+            contour.points[(reverse) ? count - 1 - i : i] =
+                {center.x + radius_x * cosf(angle), center.y + radius_y * sinf(angle)};
+        }
+    }
+
+    static unsigned CirclePointCount(float radius) {
+        unsigned count = (unsigned)ceilf(2.f * (float)M_PI * radius / kCircleSegmentLength);
+        return std::min(kCircleMaxPoints, std::max(kCircleMinPoints, count));
+    }
+
+    Circle::Circle()
+        :center_({0, 0}), radius_({0, 0}), fill_color_(255, 255, 255), border_color_(255, 255, 255),
+         border_thickness_(0) {}
+
+    void Circle::SetCenter(dr4::Vec2f center) {
+        center_ = center;
+    }
+    void Circle::SetRadius(dr4::Vec2f radius) {
+        radius_ = radius;
+    }
+    void Circle::SetFillColor(dr4::Color color) {
+        fill_color_ = color;
+    }
+    void Circle::SetBorderColor(dr4::Color color) {
+        border_color_ = color;
+    }
+    void Circle::SetBorderThickness(float thickness) {
+        border_thickness_ = thickness;
+    }
+
+    dr4::Vec2f Circle::GetCenter() const {
+        return center_;
+    }
+    dr4::Vec2f Circle::GetRadius() const {
+        return radius_;
+    }
+    dr4::Color Circle::GetFillColor() const {
+        return fill_color_;
+    }
+    float Circle::GetBorderThickness() const {
+        return border_thickness_;
+    }
+    dr4::Color Circle::GetBorderColor() const {
+        return border_color_;
+    }
+
+    // Positive border grows outwards, negative one inwards, as sf::Shape outlines do
+    void Circle::DrawOn(dr4::Texture& texture) const {
+        auto& my_texture = dynamic_cast<Texture&>(texture);
+
+        float outer = std::max(0.f, border_thickness_);
+        float inner = std::min(0.f, border_thickness_);
+        unsigned count = CirclePointCount(std::max(radius_.x, radius_.y) + outer);
+
+        Contour contours[2];
+        if (fill_color_.a != 0) {
+            BuildEllipse(contours[0], center_, radius_.x, radius_.y, count, false);
+            my_texture.FillPath(contours, 1, fill_color_);
+        }
+
+        if (border_thickness_ != 0 && border_color_.a != 0) {
+            BuildEllipse(contours[0], center_, radius_.x + outer, radius_.y + outer, count, false);
+            BuildEllipse(contours[1], center_, std::max(0.f, radius_.x + inner),
+                         std::max(0.f, radius_.y + inner), count, true);
+            my_texture.FillPath(contours, 2, border_color_);
+        }
+    }
+
+    void Circle::SetPos(dr4::Vec2f pos) {
+        center_ = {pos.x + radius_.x, pos.y + radius_.y};
+    }
+    dr4::Vec2f Circle::GetPos() const {
+        return {center_.x - radius_.x, center_.y - radius_.y};
+    }
+
+//-----------------RECTANGLE SHAPE----------------------------------------------------------------------------
+
+    RectangleShape::RectangleShape()
+        :pos_({0, 0}), size_({0, 0}), fill_color_(255, 255, 255), border_color_(255, 255, 255),
+         border_thickness_(0) {}
+
+    void RectangleShape::SetSize(dr4::Vec2f size) {
+        size_ = size;
+    }
+    void RectangleShape::SetFillColor(dr4::Color color) {
+        fill_color_ = color;
+    }
+    void RectangleShape::SetBorderThickness(float thickness) {
+        border_thickness_ = thickness;
+    }
+    void RectangleShape::SetBorderColor(dr4::Color color) {
+        border_color_ = color;
+    }
+
+    dr4::Vec2f RectangleShape::GetSize() const {
+        return size_;
+    }
+    dr4::Color RectangleShape::GetFillColor() const {
+        return fill_color_;
+    }
+    float RectangleShape::GetBorderThickness() const {
+        return border_thickness_;
+    }
+    dr4::Color RectangleShape::GetBorderColor() const {
+        return border_color_;
+    }
+
+    void RectangleShape::SetPos(dr4::Vec2f pos) {
+        pos_ = pos;
+    }
+    dr4::Vec2f RectangleShape::GetPos() const {
+        return pos_;
+    }
+
+    // Border is drawn as four bands between the outer and the inner rectangle
+    void RectangleShape::DrawOn(dr4::Texture& texture) const {
+        auto& my_texture = dynamic_cast<Texture&>(texture);
+
+        float left = std::min(pos_.x, pos_.x + size_.x);
+        float right = std::max(pos_.x, pos_.x + size_.x);
+        float top = std::min(pos_.y, pos_.y + size_.y);
+        float bottom = std::max(pos_.y, pos_.y + size_.y);
+
+        my_texture.FillRect(left, top, right, bottom, fill_color_);
+
+        if (border_thickness_ == 0 || border_color_.a == 0) {
+            return;
+        }
+
+        float outer = std::max(0.f, border_thickness_);
+        float inner = std::max(0.f, -border_thickness_);
+
+        float out_left = left - outer, out_top = top - outer;
+        float out_right = right + outer, out_bottom = bottom + outer;
+        float in_left = std::min(left + inner, right), in_top = std::min(top + inner, bottom);
+        float in_right = std::max(right - inner, in_left), in_bottom = std::max(bottom - inner, in_top);
+
+        my_texture.FillRect(out_left, out_top,   out_right, in_top,     border_color_);
+        my_texture.FillRect(out_left, in_bottom, out_right, out_bottom, border_color_);
+        my_texture.FillRect(out_left, in_top,    in_left,   in_bottom,  border_color_);
+        my_texture.FillRect(in_right, in_top,    out_right, in_bottom,  border_color_);
+    }
+
+//-----------------IMAGE--------------------------------------------------------------------------------------
+
+    Image::Image(float width, float height)
+        :surface_(std::make_shared<Surface>(width, height)) {
+        width_ = width;
+        height_ = height;
+
+        pos_ = {0, 0};
+    }
+
+    Image::Image(const Surface& surface)
+        :surface_(std::make_shared<Surface>(surface)) {
+        width_ = surface.width;
+        height_ = surface.height;
+
+        pos_ = {0, 0};
+    }
+
+    Image::~Image() {}
+
+    void Image::SetPixel(size_t x, size_t y, dr4::Color color) {
+        if (x >= surface_->width || y >= surface_->height) {
+            return;
+        }
+        GetWritableSurface().Row(y)[x] = PackColor(color);
+    }
+
+    dr4::Color Image::GetPixel(size_t x, size_t y) const {
+        if (x >= surface_->width || y >= surface_->height) {
+            return dr4::Color(0, 0, 0, 0);
+        }
+        return UnpackColor(surface_->Row(y)[x]);
+    }
+
+    void Image::SetSize(dr4::Vec2f size) {
+        width_ = size.x;
+        height_ = size.y;
+        surface_ = std::make_shared<Surface>(width_, height_);
+    }
+    dr4::Vec2f Image::GetSize() const {
+        return dr4::Vec2f(width_, height_);
+    }
+    float Image::GetWidth() const {
+        return width_;
+    }
+    float Image::GetHeight() const {
+        return height_;
+    }
+
+    void Image::SetPos(dr4::Vec2f pos) {
+        pos_ = pos;
+    }
+    dr4::Vec2f Image::GetPos() const {
+        return pos_;
+    }
+
+    void Image::DrawOn(dr4::Texture& texture) const {
+        dynamic_cast<Texture&>(texture).BlitSurface(surface_, pos_.x, pos_.y);
+    }
+
+    Surface& Image::GetWritableSurface() {
+        if (surface_.use_count() > 1) {
+            surface_ = std::make_shared<Surface>(*surface_);
+        }
+        return *surface_;
+    }
+
+//-----------------TEXTURE------------------------------------------------------------------------------------
+
+    Texture::Texture(float width, float height) {
+        main_rect_.size.x = (width > kMinWidthTexture) ? width : kMinWidthTexture;
+        main_rect_.size.y = (height > kMinWidthTexture) ? height : kMinWidthTexture;
+        main_rect_.pos = {0, 0};
+        surface_ = std::make_shared<Surface>(ceilf(main_rect_.size.x), ceilf(main_rect_.size.y));
+        clip_rect_ = main_rect_;
+        extent_ = {0, 0};
+        UpdateClip();
+    }
+
+    Texture::Texture(const Texture& other)
+        :main_rect_(other.main_rect_), clip_rect_(other.clip_rect_), surface_(),
+         clip_(other.clip_), tiles_(), extent_(other.extent_) {
+        surface_ = std::make_shared<Surface>(other.GetSurface());
+        SetTiled(other.IsTiled());
+    }
+
+    Texture::~Texture() {}
+
+    // Unlike the SFML view the clip rect only limits drawing, it doesn't move or scale it
+    void Texture::UpdateClip() {
+        ClipRect clip = {(int)floorf(extent_.x + clip_rect_.pos.x),
+                         (int)floorf(extent_.y + clip_rect_.pos.y),
+                         (int)ceilf(extent_.x + clip_rect_.pos.x + clip_rect_.size.x),
+                         (int)ceilf(extent_.y + clip_rect_.pos.y + clip_rect_.size.y)};
+        clip_ = IntersectClip(clip, SurfaceClip(*surface_));
+    }
+
+    void Texture::SetSize(dr4::Vec2f size) {
+        if (tiles_ != NULL) {
+            tiles_->Discard();
+        }
+        main_rect_.size = size;
+        surface_ = std::make_shared<Surface>((size.x > 1) ? ceilf(size.x) : 1, (size.y > 1) ? ceilf(size.y) : 1);
+        UpdateClip();
+    }
+
+    dr4::Vec2f Texture::GetSize() const {
+        return main_rect_.size;
+    }
+
+    float Texture::GetWidth() const {
+        return main_rect_.size.x;
+    }
+
+    float Texture::GetHeight() const {
+        return main_rect_.size.y;
+    }
+
+    void Texture::DrawOn(dr4::Texture& texture) const {
+        dynamic_cast<Texture&>(texture).BlitSurface(GetSnapshot(), main_rect_.pos.x, main_rect_.pos.y);
+    }
+
+    void Texture::SetZero(dr4::Vec2f pos) {
+        extent_ = pos;
+    }
+    dr4::Vec2f Texture::GetZero() const {
+        return extent_;
+    }
+
+    void Texture::SetPos(dr4::Vec2f pos) {
+        main_rect_.pos = pos;
+    }
+    dr4::Vec2f Texture::GetPos() const {
+        return main_rect_.pos;
+    }
+
+    // Everything recorded so far would be overwritten anyway
+    void Texture::Clear(dr4::Color color) {
+        if (tiles_ != NULL) {
+            tiles_->Discard();
+        }
+        Surface& surface = GetWritableSurface();
+        FillClip(surface, SurfaceClip(surface), color);
+    }
+
+    void Texture::SetClipRect(dr4::Rect2f rect) {
+        clip_rect_ = rect;
+        UpdateClip();
+    }
+
+    void Texture::RemoveClipRect() {
+        clip_rect_.size = main_rect_.size;
+        clip_rect_.pos = -extent_;
+        UpdateClip();
+    }
+
+    dr4::Rect2f Texture::GetClipRect() const {
+        return clip_rect_;
+    }
+
+    dr4::Image* Texture::GetImage() const {
+        return new Image(GetSurface());
+    }
+
+    void Texture::FillRect(float left, float top, float right, float bottom, dr4::Color color) {
+        left += extent_.x;
+        top += extent_.y;
+        right += extent_.x;
+        bottom += extent_.y;
+
+        if (tiles_ != NULL) {
+            tiles_->RecordFillRect(left, top, right, bottom, color, clip_);
+        } else {
+            soft::FillRect(GetWritableSurface(), left, top, right, bottom, color, clip_);
+        }
+    }
+
+    void Texture::FillPath(const Contour* contours, size_t count, dr4::Color color) {
+        if (tiles_ != NULL) {
+            tiles_->RecordFillPath(contours, count, {extent_.x, extent_.y}, color, clip_);
+        } else {
+            soft::FillPath(GetWritableSurface(), contours, count, {extent_.x, extent_.y}, color, clip_);
+        }
+    }
+
+    // Glyphs are placed on whole pixels, as SFML does for text
+    void Texture::BlitMask(const GlyphBitmap& glyph, float x, float y, dr4::Color color) {
+        int left = roundf(extent_.x + x);
+        int top = roundf(extent_.y + y);
+
+        if (tiles_ != NULL) {
+            tiles_->RecordBlitMask(glyph.coverage.data(), glyph.width, glyph.height, left, top, color, clip_);
+        } else {
+            soft::BlitMask(GetWritableSurface(), glyph.coverage.data(), glyph.width, glyph.height, glyph.width,
+                           left, top, color, clip_);
+        }
+    }
+
+    void Texture::BlitSurface(const SharedSurface& source, float x, float y) {
+        int left = roundf(extent_.x + x);
+        int top = roundf(extent_.y + y);
+
+        if (tiles_ != NULL) {
+            tiles_->RecordBlitSurface(source, left, top, clip_);
+        } else {
+            soft::BlitSurface(GetWritableSurface(), *source, left, top, clip_);
+        }
+    }
+
+    void Texture::SetTiled(bool enabled) {
+        if (enabled == IsTiled()) {
+            return;
+        }
+
+        if (enabled) {
+            tiles_ = std::make_unique<TileRenderer>();
+        } else {
+            Flush();
+            tiles_.reset();
+        }
+    }
+
+    void Texture::Flush() {
+        if (tiles_ != NULL && !tiles_->IsEmpty()) {
+            tiles_->Flush(GetWritableSurface());
+        }
+    }
+
+    const Surface& Texture::GetSurface() const {
+        const_cast<Texture*>(this)->Flush();
+        return *surface_;
+    }
+
+    SharedSurface Texture::GetSnapshot() const {
+        const_cast<Texture*>(this)->Flush();
+        return surface_;
+    }
+
+    Surface& Texture::GetWritableSurface() {
+        if (surface_.use_count() > 1) {
+            surface_ = std::make_shared<Surface>(*surface_);
+        }
+        return *surface_;
+    }
+
+//-----------------RENDER WINDOW------------------------------------------------------------------------------
+
+    RenderWindow::RenderWindow(size_t width, size_t height, const char* window_name)
+        :title_(window_name), is_open_(false), tiled_rendering_(false), frame_(), frame_sink_(), events_(),
+         clip_board_() {
+        width_ = width;
+        height_ = height;
+        default_font_ = NULL;
+    }
+
+    RenderWindow::~RenderWindow() {}
+
+    std::optional<dr4::Event> RenderWindow::PollEvent() {
+        if (events_.empty()) {
+            return {};
+        }
+
+        dr4::Event event = events_.front();
+        events_.pop_front();
+        return event;
+    }
+
+    void RenderWindow::PushEvent(const dr4::Event& event) {
+        events_.push_back(event);
+    }
+
+    dr4::Vec2f RenderWindow::GetSize() const {
+        return {width_, height_};
+    }
+
+    void RenderWindow::SetSize(dr4::Vec2f size) {
+        width_ = size.x;
+        height_ = size.y;
+        if (is_open_) {
+            frame_.Resize(width_, height_);
+        }
+    }
+
+    void RenderWindow::SetTitle(const std::string &title) {
+        title_ = title;
+    }
+
+    const std::string &RenderWindow::GetTitle() const {
+        return title_;
+    }
+
+    dr4::Texture *RenderWindow::CreateTexture() {
+        Texture* texture = new Texture(width_, height_);
+        texture->SetTiled(tiled_rendering_);
+        return texture;
+    }
+    dr4::Image *RenderWindow::CreateImage() {
+        return new Image(width_, height_);
+    }
+    dr4::Font *RenderWindow::CreateFont() {
+        return new Font();
+    }
+    dr4::Line *RenderWindow::CreateLine() {
+        return new Line();
+    }
+    dr4::Circle *RenderWindow::CreateCircle() {
+        return new Circle();
+    }
+    dr4::Rectangle *RenderWindow::CreateRectangle() {
+        return new RectangleShape();
+    }
+    dr4::Text *RenderWindow::CreateText() {
+        return new Text();
+    }
+
+    void RenderWindow::Draw(const dr4::Texture &texture) {
+        const Texture& my_texture = dynamic_cast<const Texture&>(texture);
+        soft::BlitSurface(frame_, my_texture.GetSurface(), 0, 0, SurfaceClip(frame_));
+    }
+
+    void RenderWindow::Open() {
+        frame_.Resize(width_, height_);
+        is_open_ = true;
+    }
+
+    void RenderWindow::Display() {
+        if (frame_sink_) {
+            frame_sink_(frame_);
+        }
+    }
+
+    bool RenderWindow::IsOpen() const {
+        return is_open_;
+    }
+
+    void RenderWindow::Close() {
+        is_open_ = false;
+    }
+
+    void RenderWindow::Clear(dr4::Color color) {
+        FillClip(frame_, SurfaceClip(frame_), color);
+    }
+
+    double RenderWindow::GetTime() {
+        return MonotonicSeconds();
+    }
+
+    void RenderWindow::Sleep(double time) {
+        PreciseSleep(time);
+    }
+
+    void RenderWindow::StartTextInput() {
+        return;
+    }
+    void RenderWindow::StopTextInput() {
+        return;
+    }
+
+    void RenderWindow::SetDefaultFont(const dr4::Font* font) {
+        default_font_ = dynamic_cast<const Font*>(font);
+    }
+    const dr4::Font* RenderWindow::GetDefaultFont() {
+        return default_font_;
+    }
+
+    void RenderWindow::SetClipboard(const std::string& string) {
+        clip_board_ = string;
+    }
+    std::string RenderWindow::GetClipboard() {
+        return clip_board_;
+    }
+
+    void RenderWindow::SetTiledRendering(bool enabled) {
+        tiled_rendering_ = enabled;
+    }
+
+    void RenderWindow::SetFrameSink(FrameSink sink) {
+        frame_sink_ = std::move(sink);
+    }
+
+//------------------------------------------------------------------------------------------------------------
+
+}
+}
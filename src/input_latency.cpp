@@ -0,0 +1,120 @@
+#include "../include/input_latency.hpp"
+
+#include <stdio.h>
+#include <math.h>
+#include <stdexcept>
+
+#include "../include/render_stats.hpp"
+
+namespace graphics {
+
+//-----------------LATENCY HISTOGRAM--------------------------------------------------------------------------
+
+    LatencyHistogram::LatencyHistogram()
+        :buckets_(), count_(0), sum_(0), min_(0), max_(0) {}
+
+    size_t LatencyHistogram::GetBucketIndex(double latency) {
+        if (!(latency >= kLatencyHistogramMin)) {
+            return 0;
+        }
+        double index = floor(log2(latency / kLatencyHistogramMin) * kLatencyBucketsPerOctave) + 1;
+        return (index < kLatencyBuckets - 1) ? (size_t)index : kLatencyBuckets - 1;
+    }
+
+    double LatencyHistogram::GetBucketUpperBound(size_t i) {
+        return kLatencyHistogramMin * exp2((double)i / kLatencyBucketsPerOctave);
+    }
+
+    void LatencyHistogram::Add(double latency) {
+        if (latency < 0) {
+            latency = 0;
+        }
+        buckets_[GetBucketIndex(latency)]++;
+        min_ = (count_ == 0 || latency < min_) ? latency : min_;
+        max_ = (count_ == 0 || latency > max_) ? latency : max_;
+        sum_ += latency;
+        count_++;
+    }
+
+    void LatencyHistogram::Reset() {
+        *this = LatencyHistogram();
+    }
+
+    double LatencyHistogram::GetPercentile(double p) const {
+        if (count_ == 0) {
+            return 0;
+        }
+        uint64_t rank = (uint64_t)ceil(p * count_);
+        rank = (rank == 0) ? 1 : rank;
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kLatencyBuckets; i++) {
+            seen += buckets_[i];
+            if (seen >= rank) {
+                double bound = GetBucketUpperBound(i);
+                return (bound < max_) ? bound : max_;
+            }
+        }
+        return max_;
+    }
+
+//-----------------INPUT LATENCY TRACKER----------------------------------------------------------------------
+
+    InputLatencyTracker::InputLatencyTracker()
+        :pending_(), histogram_(), keep_samples_(false), samples_() {}
+
+    void InputLatencyTracker::AddEvent(dr4::Event::Type type, double capture_time) {
+        if (pending_.size() < kMaxPendingLatencyEvents) {
+            pending_.push_back({type, capture_time});
+        }
+    }
+
+    void InputLatencyTracker::OnDisplay(double display_time) {
+        RenderStats& stats = RenderStats::Get();
+        for (const PendingEvent& event : pending_) {
+            histogram_.Add(display_time - event.capture_time);
+
+            if (keep_samples_ && samples_.size() < kMaxLatencySamples) {
+                samples_.push_back({event.type, event.capture_time, display_time});
+            }
+            if (stats.IsTracing()) {
+                stats.AddAsyncTraceEvent("Input latency", (uint64_t)llround(event.capture_time * 1e9),
+                                         (uint64_t)llround(display_time * 1e9));
+            }
+        }
+        pending_.clear();
+    }
+
+    void InputLatencyTracker::Reset() {
+        pending_.clear();
+        histogram_.Reset();
+        samples_.clear();
+    }
+
+    void InputLatencyTracker::SetKeepSamples(bool keep) {
+        keep_samples_ = keep;
+        if (!keep) {
+            samples_.clear();
+        }
+    }
+
+    void InputLatencyTracker::WriteSamples(const std::string& path) const {
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == NULL) {
+            throw std::runtime_error("Can't create latency samples file " + path);
+        }
+
+        fprintf(file, "type,capture_time,display_time,latency_ms\n");
+        for (const LatencySample& sample : samples_) {
+            fprintf(file, "%d,%.6f,%.6f,%.3f\n", (int)sample.type, sample.capture_time, sample.display_time,
+                    (sample.display_time - sample.capture_time) * 1e3);
+        }
+
+        bool failed = ferror(file);
+        fclose(file);
+        if (failed) {
+            throw std::runtime_error("Can't write latency samples file " + path);
+        }
+    }
+
+}
@@ -0,0 +1,70 @@
+#include "../include/pixels.hpp"
+
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace graphics {
+
+    template <typename ColorType, bool = std::is_standard_layout_v<ColorType>>
+    struct IsRgba8Layout {
+        static constexpr bool value = false;
+    };
+
+    template <typename ColorType>
+    struct IsRgba8Layout<ColorType, true> {
+        static constexpr bool value = (sizeof(ColorType) == 4)
+                                   && (offsetof(ColorType, r) == 0) && (offsetof(ColorType, g) == 1)
+                                   && (offsetof(ColorType, b) == 2) && (offsetof(ColorType, a) == 3);
+    };
+
+    // When dr4::Color is laid out as RGBA8 conversion is a plain memcpy (vectorized by libc),
+    // otherwise the loops below are simple enough for the compiler to vectorize
+    static constexpr bool kColorIsRgba8 = IsRgba8Layout<dr4::Color>::value;
+
+    void ColorsToRgba8(const dr4::Color* colors, uint8_t* pixels, size_t count) {
+        if constexpr (kColorIsRgba8) {
+            memcpy(pixels, colors, count * 4);
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                pixels[i * 4 + 0] = colors[i].r;
+                pixels[i * 4 + 1] = colors[i].g;
+                pixels[i * 4 + 2] = colors[i].b;
+                pixels[i * 4 + 3] = colors[i].a;
+            }
+        }
+    }
+
+    void Rgba8ToColors(const uint8_t* pixels, dr4::Color* colors, size_t count) {
+        if constexpr (kColorIsRgba8) {
+            memcpy((void*)colors, pixels, count * 4);
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                colors[i] = dr4::Color(pixels[i * 4 + 0], pixels[i * 4 + 1],
+                                       pixels[i * 4 + 2], pixels[i * 4 + 3]);
+            }
+        }
+    }
+
+    void FillRgba8(uint8_t* pixels, dr4::Color color, size_t count) {
+        uint8_t rgba[4] = {color.r, color.g, color.b, color.a};
+        uint32_t packed = 0;
+        memcpy(&packed, rgba, sizeof(packed));
+
+        size_t i = 0;
+#ifdef __SSE2__
+        __m128i value = _mm_set1_epi32((int)packed);
+        for (; i + 4 <= count; i += 4) {
+            _mm_storeu_si128((__m128i*)(pixels + i * 4), value);
+        }
+#endif
+        for (; i < count; i++) {
+            memcpy(pixels + i * 4, &packed, sizeof(packed));
+        }
+    }
+
+}
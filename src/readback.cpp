@@ -0,0 +1,188 @@
+#include "../include/readback.hpp"
+#include "../include/render_stats.hpp"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+#include <vector>
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+namespace graphics {
+
+    // Buffer objects and fences are GL 1.5 / 3.2 entry points that libGL doesn't have
+    // to export, they are looked up in the driver
+    struct ReadbackFunctions {
+        PFNGLGENBUFFERSPROC gen_buffers;
+        PFNGLDELETEBUFFERSPROC delete_buffers;
+        PFNGLBINDBUFFERPROC bind_buffer;
+        PFNGLBUFFERDATAPROC buffer_data;
+        PFNGLMAPBUFFERPROC map_buffer;
+        PFNGLUNMAPBUFFERPROC unmap_buffer;
+        PFNGLFENCESYNCPROC fence_sync;
+        PFNGLDELETESYNCPROC delete_sync;
+        PFNGLCLIENTWAITSYNCPROC client_wait_sync;
+
+        bool supported;
+    };
+
+    template <typename Function>
+    static bool LoadFunction(Function& function, const char* name) {
+        function = reinterpret_cast<Function>(sf::Context::getFunction(name));
+        return function != NULL;
+    }
+
+    // Needs an active context on the first call
+    static const ReadbackFunctions& GetReadbackFunctions() {
+        static const ReadbackFunctions functions = [] {
+            ReadbackFunctions loaded = {};
+            loaded.supported = LoadFunction(loaded.gen_buffers, "glGenBuffers")
+                            && LoadFunction(loaded.delete_buffers, "glDeleteBuffers")
+                            && LoadFunction(loaded.bind_buffer, "glBindBuffer")
+                            && LoadFunction(loaded.buffer_data, "glBufferData")
+                            && LoadFunction(loaded.map_buffer, "glMapBuffer")
+                            && LoadFunction(loaded.unmap_buffer, "glUnmapBuffer")
+                            && LoadFunction(loaded.fence_sync, "glFenceSync")
+                            && LoadFunction(loaded.delete_sync, "glDeleteSync")
+                            && LoadFunction(loaded.client_wait_sync, "glClientWaitSync");
+            return loaded;
+        }();
+        return functions;
+    }
+
+    // Copies GL rows (bottom row first) into top-down rows with given stride
+    static void CopyFlippedRows(const sf::Uint8* src, sf::Uint8* dst, size_t width, size_t height, size_t stride) {
+        size_t row_size = width * 4;
+        for (size_t row = 0; row < height; row++) {
+            memcpy(dst + row * stride, src + (height - 1 - row) * row_size, row_size);
+        }
+    }
+
+    static GLint FlippedTop(const sf::RenderTexture& target, sf::IntRect region) {
+        return (GLint)target.getSize().y - region.top - region.height;
+    }
+
+    static void CheckRegion(const sf::RenderTexture& target, sf::Vector2u size, sf::IntRect region) {
+        sf::Vector2u capacity = target.getSize();
+        size.x = std::min(size.x, capacity.x);
+        size.y = std::min(size.y, capacity.y);
+        if (region.left < 0 || region.top < 0 || region.width <= 0 || region.height <= 0
+            || (unsigned)(region.left + region.width) > size.x
+            || (unsigned)(region.top + region.height) > size.y) {
+            throw std::runtime_error("Readback region is out of texture bounds");
+        }
+    }
+
+    void ReadPixels(sf::RenderTexture& target, sf::Vector2u size, sf::IntRect region,
+                    sf::Uint8* pixels, size_t stride) {
+        CheckRegion(target, size, region);
+        if (!target.setActive(true)) {
+            throw std::runtime_error("Can't activate render texture for readback");
+        }
+
+        size_t row_size = region.width * 4;
+        if (stride == 0) {
+            stride = row_size;
+        }
+
+        std::vector<sf::Uint8> rows(row_size * region.height);
+
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(region.left, FlippedTop(target, region), region.width, region.height,
+                     GL_RGBA, GL_UNSIGNED_BYTE, rows.data());
+
+        CopyFlippedRows(rows.data(), pixels, region.width, region.height, stride);
+    }
+
+//-----------------ASYNC READBACK-----------------------------------------------------------------------------
+
+    // Without buffer objects or fences the pixels are read right away and kept
+    AsyncReadback::AsyncReadback(sf::RenderTexture& target, sf::Vector2u size, sf::IntRect region)
+        :buffer_(0), fence_(NULL), region_(region), ready_(false), pixels_() {
+        CheckRegion(target, size, region);
+        if (!target.setActive(true)) {
+            throw std::runtime_error("Can't activate render texture for readback");
+        }
+
+        const ReadbackFunctions& gl = GetReadbackFunctions();
+        if (!gl.supported) {
+            pixels_.resize((size_t)region.width * region.height * 4);
+            ReadPixels(target, size, region, pixels_.data());
+            ready_ = true;
+            return;
+        }
+
+        gl.gen_buffers(1, &buffer_);
+        gl.bind_buffer(GL_PIXEL_PACK_BUFFER, buffer_);
+        gl.buffer_data(GL_PIXEL_PACK_BUFFER, (size_t)region.width * region.height * 4, NULL, GL_STREAM_READ);
+
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(region.left, FlippedTop(target, region), region.width, region.height,
+                     GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+        gl.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        fence_ = gl.fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+    }
+
+    AsyncReadback::~AsyncReadback() {
+        const ReadbackFunctions& gl = GetReadbackFunctions();
+        if (fence_ != NULL) {
+            gl.delete_sync(fence_);
+        }
+        if (buffer_ != 0) {
+            gl.delete_buffers(1, &buffer_);
+        }
+    }
+
+    bool AsyncReadback::IsReady() {
+        if (ready_) {
+            return true;
+        }
+
+        GLenum status = GetReadbackFunctions().client_wait_sync(fence_, 0, 0);
+        ready_ = (status == GL_ALREADY_SIGNALED) || (status == GL_CONDITION_SATISFIED);
+        return ready_;
+    }
+
+    bool AsyncReadback::Fetch(sf::Uint8* pixels, size_t stride) {
+        if (!IsReady()) {
+            return false;
+        }
+
+        size_t row_size = (size_t)region_.width * 4;
+        if (stride == 0) {
+            stride = row_size;
+        }
+
+        // Counted when the pixels arrive, requests that are never fetched read nothing
+        if (buffer_ == 0) {
+            for (int row = 0; row < region_.height; row++) {
+                memcpy(pixels + row * stride, pixels_.data() + row * row_size, row_size);
+            }
+            RenderStats::Get().CountReadback(row_size * region_.height);
+            return true;
+        }
+
+        const ReadbackFunctions& gl = GetReadbackFunctions();
+        gl.bind_buffer(GL_PIXEL_PACK_BUFFER, buffer_);
+        const sf::Uint8* mapped = (const sf::Uint8*)gl.map_buffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+        if (mapped == NULL) {
+            gl.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+            throw std::runtime_error("Can't map readback buffer");
+        }
+
+        CopyFlippedRows(mapped, pixels, region_.width, region_.height, stride);
+
+        gl.unmap_buffer(GL_PIXEL_PACK_BUFFER);
+        gl.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+        RenderStats::Get().CountReadback(row_size * region_.height);
+        return true;
+    }
+
+//------------------------------------------------------------------------------------------------------------
+
+}
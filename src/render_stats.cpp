@@ -0,0 +1,113 @@
+#include "../include/render_stats.hpp"
+
+#include <stdio.h>
+#include <stdexcept>
+
+#include "../include/frame_pacer.hpp"
+
+namespace graphics {
+
+//-----------------RENDER STATS-------------------------------------------------------------------------------
+
+    RenderStats::RenderStats()
+        :current_(), last_(), frame_start_(MonotonicNanoseconds()),
+         tracing_(false), trace_(), trace_frames_() {}
+
+    RenderStats& RenderStats::Get() {
+        static RenderStats stats;
+        return stats;
+    }
+
+    void RenderStats::EndFrame(double display_time) {
+        uint64_t now = MonotonicNanoseconds();
+        current_.display_time = display_time;
+        current_.frame_time = (now - frame_start_) * 1e-9;
+
+        if (tracing_) {
+            AddTraceEvent("Frame", frame_start_, now);
+            if (trace_frames_.size() < kMaxTraceEvents) {
+                trace_frames_.push_back({now, current_});
+            }
+        }
+
+        last_ = current_;
+        current_ = {};
+        frame_start_ = now;
+    }
+
+    void RenderStats::StartTrace() {
+        trace_.clear();
+        trace_frames_.clear();
+        tracing_ = true;
+    }
+
+    void RenderStats::StopTrace() {
+        tracing_ = false;
+    }
+
+    void RenderStats::AddTraceEvent(const char* name, uint64_t start, uint64_t end) {
+        if (!tracing_ || trace_.size() >= kMaxTraceEvents) {
+            return;
+        }
+        trace_.push_back({name, start, end - start, false});
+    }
+
+    void RenderStats::AddAsyncTraceEvent(const char* name, uint64_t start, uint64_t end) {
+        if (!tracing_ || trace_.size() >= kMaxTraceEvents) {
+            return;
+        }
+        trace_.push_back({name, start, end - start, true});
+    }
+
+    // Trace-event timestamps are microseconds
+    void RenderStats::WriteTrace(const std::string& path) const {
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == NULL) {
+            throw std::runtime_error("Can't open trace file " + path);
+        }
+
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        size_t async_id = 0;
+        for (const TraceEvent& event : trace_) {
+            if (event.async) {
+                async_id++;
+                fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"async\",\"ph\":\"b\",\"id\":%zu,\"pid\":1,\"tid\":2,"
+                              "\"ts\":%.3f},\n"
+                              "{\"name\":\"%s\",\"cat\":\"async\",\"ph\":\"e\",\"id\":%zu,\"pid\":1,\"tid\":2,\"ts\":%.3f}",
+                        first ? "" : ",\n", event.name, async_id, event.start * 1e-3,
+                        event.name, async_id, (event.start + event.duration) * 1e-3);
+            } else {
+                fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                        first ? "" : ",\n", event.name, event.start * 1e-3, event.duration * 1e-3);
+            }
+            first = false;
+        }
+        for (const std::pair<uint64_t, FrameStats>& frame : trace_frames_) {
+            const FrameStats& stats = frame.second;
+            fprintf(file, "%s{\"name\":\"Frame stats\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":"
+                          "{\"draw_calls\":%zu,\"vertices\":%zu,\"uploads\":%zu,\"resolves\":%zu,\"readbacks\":%zu}}",
+                    first ? "" : ",\n", frame.first * 1e-3, stats.draw_calls, stats.vertices,
+                    stats.uploads, stats.resolves, stats.readbacks);
+            first = false;
+        }
+        fprintf(file, "\n]}\n");
+
+        bool failed = ferror(file);
+        if (fclose(file) != 0 || failed) {
+            throw std::runtime_error("Can't write trace file " + path);
+        }
+    }
+
+//-----------------TRACE SCOPE--------------------------------------------------------------------------------
+
+    TraceScope::TraceScope(const char* name)
+        :name_(name), start_(RenderStats::Get().IsTracing() ? MonotonicNanoseconds() : 0) {}
+
+    TraceScope::~TraceScope() {
+        if (start_ != 0) {
+            RenderStats::Get().AddTraceEvent(name_, start_, MonotonicNanoseconds());
+        }
+    }
+
+}
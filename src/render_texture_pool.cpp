@@ -0,0 +1,83 @@
+#include "../include/render_texture_pool.hpp"
+
+#include <stdexcept>
+
+namespace graphics {
+
+    RenderTexturePool::RenderTexturePool()
+        :free_(), stats_({0, 0, 0, 0, 0}) {}
+
+    RenderTexturePool::~RenderTexturePool() {
+        Clear();
+    }
+
+    RenderTexturePool& RenderTexturePool::Get() {
+        static RenderTexturePool pool;
+        return pool;
+    }
+
+    // Powers of two for small sizes, fixed steps for big ones
+    unsigned RenderTexturePool::BucketSize(unsigned size) {
+        if (size <= kPoolMinBucket) {
+            return kPoolMinBucket;
+        }
+        if (size <= kPoolPowerOfTwoLimit) {
+            unsigned bucket = kPoolMinBucket;
+            while (bucket < size) {
+                bucket *= 2;
+            }
+            return bucket;
+        }
+        return (size + kPoolLargeBucketStep - 1) / kPoolLargeBucketStep * kPoolLargeBucketStep;
+    }
+
+    sf::RenderTexture* RenderTexturePool::Acquire(unsigned width, unsigned height) {
+        std::pair<unsigned, unsigned> bucket(BucketSize(width), BucketSize(height));
+
+        auto free_itr = free_.find(bucket);
+        if (free_itr != free_.end() && !free_itr->second.empty()) {
+            sf::RenderTexture* target = free_itr->second.back();
+            free_itr->second.pop_back();
+            stats_.free--;
+            stats_.reused++;
+            return target;
+        }
+
+        sf::RenderTexture* target = new sf::RenderTexture();
+        if (!target->create(bucket.first, bucket.second)) {
+            delete target;
+            throw std::runtime_error("Can't create render texture");
+        }
+        stats_.created++;
+        return target;
+    }
+
+    void RenderTexturePool::Release(sf::RenderTexture* target) {
+        if (target == NULL) {
+            return;
+        }
+
+        stats_.released++;
+        if (stats_.free >= kPoolMaxFreeTargets) {
+            delete target;
+            stats_.destroyed++;
+            return;
+        }
+
+        sf::Vector2u size = target->getSize();
+        free_[{size.x, size.y}].push_back(target);
+        stats_.free++;
+    }
+
+    void RenderTexturePool::Clear() {
+        for (auto& bucket : free_) {
+            for (sf::RenderTexture* target : bucket.second) {
+                delete target;
+                stats_.destroyed++;
+            }
+        }
+        free_.clear();
+        stats_.free = 0;
+    }
+
+}
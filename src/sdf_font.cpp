@@ -0,0 +1,201 @@
+#include "../include/sdf_font.hpp"
+#include "../include/glyph_layout.hpp"
+
+#include <math.h>
+#include <stdexcept>
+#include <algorithm>
+
+namespace graphics {
+
+    static const char* const kSdfFragmentShader =
+        "uniform sampler2D texture;\n"
+        "void main() {\n"
+        "    float distance = texture2D(texture, gl_TexCoord[0].xy).a;\n"
+        "    float width = fwidth(distance);\n"
+        "    float alpha = smoothstep(0.5 - width, 0.5 + width, distance);\n"
+        "    gl_FragColor = vec4(gl_Color.rgb, gl_Color.a * alpha);\n"
+        "}\n";
+
+    static const sf::Uint8 kSdfCoverageThreshold = 128;
+
+    SdfAtlas::SdfAtlas(const sf::Font& font)
+        :font_(font), image_(), texture_(), glyphs_(), shelf_x_(0), shelf_y_(0), shelf_height_(0) {
+        image_.create(kSdfAtlasWidth, kSdfAtlasStartHeight, sf::Color(255, 255, 255, 0));
+        if (!texture_.loadFromImage(image_)) {
+            throw std::runtime_error("Can't create SDF atlas texture");
+        }
+        texture_.setSmooth(true);
+    }
+
+    const sf::Shader* SdfAtlas::GetShader() {
+        // Leaked on purpose: GL may be gone during static destruction
+        static sf::Shader* shader = NULL;
+        static bool loaded = false;
+
+        if (!loaded) {
+            loaded = true;
+            if (sf::Shader::isAvailable()) {
+                shader = new sf::Shader();
+                if (shader->loadFromMemory(kSdfFragmentShader, sf::Shader::Fragment)) {
+                    shader->setUniform("texture", sf::Shader::CurrentTexture);
+                } else {
+                    delete shader;
+                    shader = NULL;
+                }
+            }
+        }
+
+        return shader;
+    }
+
+    void SdfAtlas::GrowAtlas() {
+        sf::Vector2u size = image_.getSize();
+        if (size.y * 2 > sf::Texture::getMaximumSize()) {
+            throw std::runtime_error("SDF atlas is full");
+        }
+
+        sf::Image grown;
+        grown.create(size.x, size.y * 2, sf::Color(255, 255, 255, 0));
+        grown.copy(image_, 0, 0);
+        image_ = grown;
+
+        if (!texture_.loadFromImage(image_)) {
+            throw std::runtime_error("Can't grow SDF atlas texture");
+        }
+    }
+
+    // Shelf packing with one pixel gap, so smooth sampling doesn't bleed between glyphs
+    sf::IntRect SdfAtlas::AllocateRect(unsigned width, unsigned height) {
+        if (width + 1 > kSdfAtlasWidth) {
+            throw std::runtime_error("Glyph is too big for SDF atlas");
+        }
+
+        if (shelf_x_ + width + 1 > kSdfAtlasWidth) {
+            shelf_y_ += shelf_height_;
+            shelf_x_ = 0;
+            shelf_height_ = 0;
+        }
+
+        while (shelf_y_ + height + 1 > image_.getSize().y) {
+            GrowAtlas();
+        }
+
+        sf::IntRect rect(shelf_x_, shelf_y_, width, height);
+        shelf_x_ += width + 1;
+        shelf_height_ = std::max(shelf_height_, height + 1);
+        return rect;
+    }
+
+    void SdfAtlas::LoadGlyphs(const std::vector<sf::Uint32>& codepoints) {
+        // Rasterize everything first so the page is read back once
+        for (sf::Uint32 codepoint : codepoints) {
+            font_.getGlyph(codepoint, kSdfBaseSize, false);
+        }
+        sf::Image page = font_.getTexture(kSdfBaseSize).copyToImage();
+
+        const int spread = kSdfSpread;
+        std::vector<sf::Uint8> inside;
+        std::vector<sf::Uint8> tile;
+
+        for (sf::Uint32 codepoint : codepoints) {
+            const sf::Glyph& glyph = font_.getGlyph(codepoint, kSdfBaseSize, false);
+
+            SdfGlyph sdf_glyph;
+            sdf_glyph.advance = glyph.advance;
+            sdf_glyph.ink_bounds = glyph.bounds;
+
+            sf::IntRect source = glyph.textureRect;
+            if (source.width <= 0 || source.height <= 0) {
+                sdf_glyph.bounds = sf::FloatRect();
+                sdf_glyph.texture_rect = sf::IntRect();
+                glyphs_[codepoint] = sdf_glyph;
+                continue;
+            }
+
+            int width = source.width + 2 * spread;
+            int height = source.height + 2 * spread;
+
+            inside.assign(width * height, 0);
+            for (int y = 0; y < source.height; y++) {
+                for (int x = 0; x < source.width; x++) {
+                    sf::Color pixel = page.getPixel(source.left + x, source.top + y);
+                    inside[(y + spread) * width + x + spread] = (pixel.a >= kSdfCoverageThreshold);
+                }
+            }
+
+            // Brute force search of the nearest pixel of the other side within the spread
+            tile.resize(width * height * 4);
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    bool is_inside = inside[y * width + x];
+                    int min_sq_dist = spread * spread;
+
+                    int y_from = std::max(0, y - spread), y_to = std::min(height - 1, y + spread);
+                    int x_from = std::max(0, x - spread), x_to = std::min(width - 1, x + spread);
+                    for (int ny = y_from; ny <= y_to; ny++) {
+                        for (int nx = x_from; nx <= x_to; nx++) {
+                            if (inside[ny * width + nx] != is_inside) {
+                                int sq_dist = (nx - x) * (nx - x) + (ny - y) * (ny - y);
+                                min_sq_dist = std::min(min_sq_dist, sq_dist);
+                            }
+                        }
+                    }
+
+                    float dist = sqrtf((float)min_sq_dist) - 0.5f;
+                    float value = 0.5f + ((is_inside) ? dist : -dist) / (2.f * spread);
+                    value = std::min(1.f, std::max(0.f, value));
+
+                    sf::Uint8* texel = &tile[(y * width + x) * 4];
+                    texel[0] = 255;
+                    texel[1] = 255;
+                    texel[2] = 255;
+                    texel[3] = (sf::Uint8)(value * 255.f + 0.5f);
+                }
+            }
+
+            sf::IntRect rect = AllocateRect(width, height);
+            sf::Image tile_image;
+            tile_image.create(width, height, tile.data());
+            image_.copy(tile_image, rect.left, rect.top);
+            texture_.update(tile.data(), width, height, rect.left, rect.top);
+
+            sdf_glyph.texture_rect = rect;
+            sdf_glyph.bounds = sf::FloatRect(glyph.bounds.left - spread, glyph.bounds.top - spread, width, height);
+            glyphs_[codepoint] = sdf_glyph;
+        }
+    }
+
+    // Same pen movement as sf::Text, but quads come from the base size glyphs scaled down
+    sf::FloatRect SdfAtlas::BuildVertices(const sf::String& string, unsigned size, sf::Color color,
+                                          std::vector<sf::Vertex>& vertices) {
+        std::vector<sf::Uint32> missing;
+        for (size_t i = 0; i < string.getSize(); i++) {
+            sf::Uint32 codepoint = string[i];
+            if (codepoint != L' ' && codepoint != L'\t' && codepoint != L'\n' && codepoint != L'\r'
+                && glyphs_.find(codepoint) == glyphs_.end()
+                && std::find(missing.begin(), missing.end(), codepoint) == missing.end()) {
+                missing.push_back(codepoint);
+            }
+        }
+        if (!missing.empty()) {
+            LoadGlyphs(missing);
+        }
+
+        float scale = (float)size / kSdfBaseSize;
+        auto scaled = [scale](sf::FloatRect rect) {
+            return sf::FloatRect(rect.left * scale, rect.top * scale, rect.width * scale, rect.height * scale);
+        };
+
+        auto kerning = [&](sf::Uint32 prev, sf::Uint32 codepoint) {
+            return font_.getKerning(prev, codepoint, kSdfBaseSize) * scale;
+        };
+        auto glyph_lookup = [&](sf::Uint32 codepoint) {
+            const SdfGlyph& glyph = glyphs_[codepoint];
+            return LayoutGlyph{glyph.advance * scale, scaled(glyph.bounds), scaled(glyph.ink_bounds),
+                               sf::FloatRect(glyph.texture_rect)};
+        };
+        return LayoutGlyphs(string, size, font_.getGlyph(L' ', kSdfBaseSize, false).advance * scale,
+                            font_.getLineSpacing(kSdfBaseSize) * scale, color, kerning, glyph_lookup, vertices);
+    }
+
+}
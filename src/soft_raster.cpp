@@ -0,0 +1,408 @@
+#include "../include/soft_raster.hpp"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "../include/pixels.hpp"
+
+namespace graphics {
+namespace soft {
+
+    static const float kFullCoverage = 0.999f;
+    static const float kMinCoverage = 1.f / 512;
+
+    static inline unsigned Div255(unsigned value) {
+        return ((value + 128) * 257) >> 16;
+    }
+
+    static inline unsigned CoverageToByte(float coverage) {
+        return (unsigned)(std::min(coverage, 1.f) * 255.f + 0.5f);
+    }
+
+#ifdef __SSE2__
+    static inline __m128i Div255(__m128i value) {
+        return _mm_mulhi_epu16(_mm_add_epi16(value, _mm_set1_epi16(128)), _mm_set1_epi16(257));
+    }
+#endif
+
+    ClipRect IntersectClip(const ClipRect& first, const ClipRect& second) {
+        return {std::max(first.left, second.left),   std::max(first.top, second.top),
+                std::min(first.right, second.right), std::min(first.bottom, second.bottom)};
+    }
+
+    ClipRect SurfaceClip(const Surface& surface) {
+        return {0, 0, (int)surface.width, (int)surface.height};
+    }
+
+    uint32_t PackColor(dr4::Color color) {
+        uint8_t rgba[4] = {color.r, color.g, color.b, color.a};
+        uint32_t pixel = 0;
+        memcpy(&pixel, rgba, sizeof(pixel));
+        return pixel;
+    }
+
+    dr4::Color UnpackColor(uint32_t pixel) {
+        uint8_t rgba[4] = {};
+        memcpy(rgba, &pixel, sizeof(pixel));
+        return dr4::Color(rgba[0], rgba[1], rgba[2], rgba[3]);
+    }
+
+//-----------------BLENDING-----------------------------------------------------------------------------------
+
+    void BlendPixel(uint32_t* pixel, dr4::Color color, unsigned coverage) {
+        unsigned alpha = Div255(color.a * coverage);
+        if (alpha == 0) {
+            return;
+        }
+
+        uint8_t* dst = (uint8_t*)pixel;
+        unsigned inv = 255 - alpha;
+        dst[0] = Div255(color.r * alpha + dst[0] * inv);
+        dst[1] = Div255(color.g * alpha + dst[1] * inv);
+        dst[2] = Div255(color.b * alpha + dst[2] * inv);
+        dst[3] = Div255(alpha * 255 + dst[3] * inv);
+    }
+
+    void BlendSpan(uint32_t* pixels, size_t count, dr4::Color color) {
+        if (color.a == 0) {
+            return;
+        }
+        if (color.a == 255) {
+            FillRgba8((uint8_t*)pixels, color, count);
+            return;
+        }
+
+        size_t i = 0;
+#ifdef __SSE2__
+        // Two pixels per register in 16-bit lanes: (src * w + dst * (255 - a)) / 255,
+        // w = (a, a, a, 255), both products together never exceed 255 * 255
+        short a = color.a;
+        __m128i zero = _mm_setzero_si128();
+        __m128i premul = _mm_set_epi16(a * 255, color.b * a, color.g * a, color.r * a,
+                                       a * 255, color.b * a, color.g * a, color.r * a);
+        __m128i inv = _mm_set1_epi16(255 - a);
+        for (; i + 4 <= count; i += 4) {
+            __m128i dst = _mm_loadu_si128((const __m128i*)(pixels + i));
+            __m128i lo = _mm_unpacklo_epi8(dst, zero);
+            __m128i hi = _mm_unpackhi_epi8(dst, zero);
+            lo = Div255(_mm_add_epi16(_mm_mullo_epi16(lo, inv), premul));
+            hi = Div255(_mm_add_epi16(_mm_mullo_epi16(hi, inv), premul));
+            _mm_storeu_si128((__m128i*)(pixels + i), _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for (; i < count; i++) {
+            BlendPixel(pixels + i, color, 255);
+        }
+    }
+
+    // Per-pixel source alpha version of BlendSpan
+    static void BlendRow(uint32_t* dst, const uint32_t* src, size_t count) {
+        size_t i = 0;
+#ifdef __SSE2__
+        __m128i zero = _mm_setzero_si128();
+        __m128i rgb_mask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+        __m128i alpha_one = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+        __m128i full = _mm_set1_epi16(255);
+        for (; i + 4 <= count; i += 4) {
+            __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+            __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+
+            __m128i s_lo = _mm_unpacklo_epi8(s, zero);
+            __m128i s_hi = _mm_unpackhi_epi8(s, zero);
+            __m128i d_lo = _mm_unpacklo_epi8(d, zero);
+            __m128i d_hi = _mm_unpackhi_epi8(d, zero);
+
+            __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            __m128i a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+            __m128i w_lo = _mm_or_si128(_mm_and_si128(a_lo, rgb_mask), alpha_one);
+            __m128i w_hi = _mm_or_si128(_mm_and_si128(a_hi, rgb_mask), alpha_one);
+
+            __m128i lo = _mm_add_epi16(_mm_mullo_epi16(s_lo, w_lo), _mm_mullo_epi16(d_lo, _mm_sub_epi16(full, a_lo)));
+            __m128i hi = _mm_add_epi16(_mm_mullo_epi16(s_hi, w_hi), _mm_mullo_epi16(d_hi, _mm_sub_epi16(full, a_hi)));
+
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(Div255(lo), Div255(hi)));
+        }
+#endif
+        for (; i < count; i++) {
+            BlendPixel(dst + i, UnpackColor(src[i]), 255);
+        }
+    }
+
+//-----------------FILLS--------------------------------------------------------------------------------------
+
+    void FillClip(Surface& surface, const ClipRect& rect, dr4::Color color) {
+        ClipRect area = IntersectClip(rect, SurfaceClip(surface));
+        if (area.IsEmpty()) {
+            return;
+        }
+        for (int y = area.top; y < area.bottom; y++) {
+            FillRgba8((uint8_t*)(surface.Row(y) + area.left), color, area.right - area.left);
+        }
+    }
+
+    void FillRect(Surface& surface, float left, float top, float right, float bottom,
+                  dr4::Color color, const ClipRect& clip) {
+        ClipRect area = IntersectClip(clip, SurfaceClip(surface));
+        left = std::max(left, (float)area.left);
+        top = std::max(top, (float)area.top);
+        right = std::min(right, (float)area.right);
+        bottom = std::min(bottom, (float)area.bottom);
+        if (left >= right || top >= bottom) {
+            return;
+        }
+
+        int x0 = (int)floorf(left);
+        int x1 = (int)ceilf(right);
+        int y0 = (int)floorf(top);
+        int y1 = (int)ceilf(bottom);
+
+        for (int y = y0; y < y1; y++) {
+            float cover_y = std::min(bottom, (float)(y + 1)) - std::max(top, (float)y);
+            uint32_t* row = surface.Row(y);
+
+            if (x1 - x0 == 1) {
+                BlendPixel(row + x0, color, CoverageToByte(cover_y * (right - left)));
+                continue;
+            }
+
+            BlendPixel(row + x0, color, CoverageToByte(cover_y * ((float)(x0 + 1) - left)));
+            if (cover_y >= kFullCoverage) {
+                BlendSpan(row + x0 + 1, x1 - x0 - 2, color);
+            } else {
+                unsigned coverage = CoverageToByte(cover_y);
+                for (int x = x0 + 1; x < x1 - 1; x++) {
+                    BlendPixel(row + x, color, coverage);
+                }
+            }
+            BlendPixel(row + x1 - 1, color, CoverageToByte(cover_y * (right - (float)(x1 - 1))));
+        }
+    }
+
+    // Sutherland-Hodgman against the four clip edges, keeps the covered area exact
+    static void ClipContour(const std::vector<PathPoint>& input, PathPoint offset,
+                            std::vector<PathPoint>& output, const ClipRect& clip) {
+        std::vector<PathPoint> buffer;
+        output.clear();
+        for (PathPoint point : input) {
+            output.push_back({point.x + offset.x, point.y + offset.y});
+        }
+
+        for (int edge = 0; edge < 4; edge++) {
+            buffer.swap(output);
+            output.clear();
+            if (buffer.empty()) {
+                return;
+            }
+
+            auto distance = [edge, &clip](PathPoint point) {
+                switch (edge) {
+                    case 0:  return point.x - clip.left;
+                    case 1:  return clip.right - point.x;
+                    case 2:  return point.y - clip.top;
+                    default: return clip.bottom - point.y;
+                }
+            };
+
+            PathPoint prev = buffer.back();
+            float prev_dist = distance(prev);
+            for (PathPoint cur : buffer) {
+                float cur_dist = distance(cur);
+                if ((cur_dist >= 0) != (prev_dist >= 0)) {
+                    float t = prev_dist / (prev_dist - cur_dist);
+                    output.push_back({prev.x + (cur.x - prev.x) * t, prev.y + (cur.y - prev.y) * t});
+                }
+                if (cur_dist >= 0) {
+                    output.push_back(cur);
+                }
+                prev = cur;
+                prev_dist = cur_dist;
+            }
+        }
+    }
+
+    // Signed area accumulation: every edge adds the area it covers to the right of it,
+    // the running sum along a row is then the exact coverage of each pixel
+    static void AccumulateLine(float* acc, size_t stride, int width, int height, PathPoint p0, PathPoint p1) {
+        if (fabsf(p0.y - p1.y) <= FLT_EPSILON) {
+            return;
+        }
+
+        float dir = 1.f;
+        if (p0.y > p1.y) {
+            std::swap(p0, p1);
+            dir = -1.f;
+        }
+
+        float dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+        float x = p0.x;
+        int y_end = std::min(height, (int)ceilf(p1.y));
+
+        for (int y = (int)p0.y; y < y_end; y++) {
+            float* line = acc + (size_t)y * stride;
+            float dy = std::min((float)(y + 1), p1.y) - std::max((float)y, p0.y);
+            float x_next = x + dxdy * dy;
+            float d = dy * dir;
+
+            // Nearly horizontal edges accumulate rounding errors, x must stay inside the row
+            float x0 = std::max(0.f, std::min(x, x_next));
+            float x1 = std::max(x0, std::min((float)width, std::max(x, x_next)));
+            float x0_floor = floorf(x0);
+            float x1_ceil = ceilf(x1);
+            int x0i = (int)x0_floor;
+            int x1i = (int)x1_ceil;
+
+            if (x1i <= x0i + 1) {
+                float xmf = 0.5f * (x0 + x1) - x0_floor;
+                line[x0i] += d - d * xmf;
+                line[x0i + 1] += d * xmf;
+            } else {
+                float s = 1.f / (x1 - x0);
+                float x0f = x0 - x0_floor;
+                float a0 = 0.5f * s * (1.f - x0f) * (1.f - x0f);
+                float x1f = x1 - x1_ceil + 1.f;
+                float am = 0.5f * s * x1f * x1f;
+
+                line[x0i] += d * a0;
+                if (x1i == x0i + 2) {
+                    line[x0i + 1] += d * (1.f - a0 - am);
+                } else {
+                    float a1 = s * (1.5f - x0f);
+                    line[x0i + 1] += d * (a1 - a0);
+                    for (int xi = x0i + 2; xi < x1i - 1; xi++) {
+                        line[xi] += d * s;
+                    }
+                    float a2 = a1 + (x1i - x0i - 3) * s;
+                    line[x1i - 1] += d * (1.f - a2 - am);
+                }
+                line[x1i] += d * am;
+            }
+
+            x = x_next;
+        }
+    }
+
+    void FillPath(Surface& surface, const Contour* contours, size_t count, PathPoint offset,
+                  dr4::Color color, const ClipRect& clip) {
+        ClipRect area = IntersectClip(clip, SurfaceClip(surface));
+        if (area.IsEmpty() || color.a == 0) {
+            return;
+        }
+
+        // Buffers are per thread, tiles of the same path can be filled in parallel
+        thread_local std::vector<Contour> clipped;
+        thread_local std::vector<float> acc;
+
+        clipped.resize(count);
+        float min_x = area.right, min_y = area.bottom, max_x = area.left, max_y = area.top;
+        for (size_t i = 0; i < count; i++) {
+            ClipContour(contours[i].points, offset, clipped[i].points, area);
+            for (PathPoint point : clipped[i].points) {
+                min_x = std::min(min_x, point.x);
+                min_y = std::min(min_y, point.y);
+                max_x = std::max(max_x, point.x);
+                max_y = std::max(max_y, point.y);
+            }
+        }
+
+        int origin_x = (int)floorf(min_x);
+        int origin_y = (int)floorf(min_y);
+        int width = (int)ceilf(max_x) - origin_x;
+        int height = (int)ceilf(max_y) - origin_y;
+        if (width <= 0 || height <= 0) {
+            return;
+        }
+
+        // Accumulated values are zeroed right after being read, so the buffer stays clean
+        size_t stride = width + 2;
+        if (acc.size() < stride * height) {
+            acc.resize(stride * height, 0.f);
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            const std::vector<PathPoint>& points = clipped[i].points;
+            for (size_t j = 0; j < points.size(); j++) {
+                PathPoint p0 = points[j];
+                PathPoint p1 = points[(j + 1) % points.size()];
+                p0 = {std::min(std::max(p0.x - origin_x, 0.f), (float)width), std::max(p0.y - origin_y, 0.f)};
+                p1 = {std::min(std::max(p1.x - origin_x, 0.f), (float)width), std::max(p1.y - origin_y, 0.f)};
+                AccumulateLine(acc.data(), stride, width, height, p0, p1);
+            }
+        }
+
+        for (int y = 0; y < height; y++) {
+            float* line = acc.data() + (size_t)y * stride;
+            uint32_t* row = surface.Row(origin_y + y) + origin_x;
+
+            float sum = 0.f;
+            int run_start = -1;
+            for (int x = 0; x < width; x++) {
+                sum += line[x];
+                line[x] = 0.f;
+                float coverage = fabsf(sum);
+
+                if (coverage >= kFullCoverage) {
+                    if (run_start < 0) {
+                        run_start = x;
+                    }
+                    continue;
+                }
+                if (run_start >= 0) {
+                    BlendSpan(row + run_start, x - run_start, color);
+                    run_start = -1;
+                }
+                if (coverage > kMinCoverage) {
+                    BlendPixel(row + x, color, CoverageToByte(coverage));
+                }
+            }
+            if (run_start >= 0) {
+                BlendSpan(row + run_start, width - run_start, color);
+            }
+            line[width] = 0.f;
+            line[width + 1] = 0.f;
+        }
+    }
+
+//-----------------BLITS--------------------------------------------------------------------------------------
+
+    void BlitSurface(Surface& dst, const Surface& src, int x, int y, const ClipRect& clip) {
+        ClipRect area = IntersectClip(IntersectClip(clip, SurfaceClip(dst)),
+                                      {x, y, x + (int)src.width, y + (int)src.height});
+        if (area.IsEmpty()) {
+            return;
+        }
+
+        for (int row = area.top; row < area.bottom; row++) {
+            BlendRow(dst.Row(row) + area.left, src.Row(row - y) + (area.left - x), area.right - area.left);
+        }
+    }
+
+    void BlitMask(Surface& dst, const uint8_t* mask, unsigned width, unsigned height, size_t pitch,
+                  int x, int y, dr4::Color color, const ClipRect& clip) {
+        ClipRect area = IntersectClip(IntersectClip(clip, SurfaceClip(dst)),
+                                      {x, y, x + (int)width, y + (int)height});
+        if (area.IsEmpty()) {
+            return;
+        }
+
+        for (int row = area.top; row < area.bottom; row++) {
+            const uint8_t* coverage = mask + (size_t)(row - y) * pitch + (area.left - x);
+            uint32_t* pixels = dst.Row(row);
+            for (int col = area.left; col < area.right; col++, coverage++) {
+                if (*coverage != 0) {
+                    BlendPixel(pixels + col, color, *coverage);
+                }
+            }
+        }
+    }
+
+//------------------------------------------------------------------------------------------------------------
+
+}
+}
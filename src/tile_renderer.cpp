@@ -0,0 +1,300 @@
+#include "../include/tile_renderer.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace graphics {
+namespace soft {
+
+//-----------------WORK STEALING POOL-------------------------------------------------------------------------
+
+    WorkStealingPool::WorkStealingPool(size_t thread_count)
+        :threads_(), queues_(), task_(NULL), generation_(0), remaining_(0), stop_(false) {
+        for (size_t i = 0; i < thread_count + 1; i++) {
+            queues_.push_back(std::make_unique<TaskQueue>());
+        }
+        for (size_t i = 0; i < thread_count; i++) {
+            threads_.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+        }
+    }
+
+    WorkStealingPool::~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    WorkStealingPool& WorkStealingPool::Get() {
+        static WorkStealingPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+    bool WorkStealingPool::PopTask(size_t self, size_t& index) {
+        {
+            TaskQueue& own = *queues_[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                index = own.tasks.back();
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+
+        for (size_t i = 1; i < queues_.size(); i++) {
+            TaskQueue& victim = *queues_[(self + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                index = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // task_ is read after a successful pop: it is set before the tasks are queued
+    // and stays the same until the last of them is done
+    void WorkStealingPool::RunTasks(size_t self) {
+        size_t index = 0;
+        while (PopTask(self, index)) {
+            (*task_)(index);
+            if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_.notify_all();
+            }
+        }
+    }
+
+    void WorkStealingPool::WorkerLoop(size_t self) {
+        size_t seen_generation = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] {return stop_ || generation_ != seen_generation;});
+                if (stop_) {
+                    return;
+                }
+                seen_generation = generation_;
+            }
+            RunTasks(self);
+        }
+    }
+
+    void WorkStealingPool::ParallelFor(size_t count, const std::function<void(size_t)>& task) {
+        if (count == 0) {
+            return;
+        }
+        if (threads_.empty() || count == 1) {
+            for (size_t i = 0; i < count; i++) {
+                task(i);
+            }
+            return;
+        }
+
+        task_ = &task;
+        remaining_.store(count, std::memory_order_release);
+
+        // Contiguous chunks keep neighbouring tasks on one worker until stealing starts
+        size_t chunk = (count + queues_.size() - 1) / queues_.size();
+        for (size_t queue = 0; queue < queues_.size(); queue++) {
+            std::lock_guard<std::mutex> lock(queues_[queue]->mutex);
+            for (size_t i = queue * chunk; i < std::min(count, (queue + 1) * chunk); i++) {
+                queues_[queue]->tasks.push_back(i);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            generation_++;
+        }
+        wake_.notify_all();
+
+        RunTasks(queues_.size() - 1);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] {return remaining_.load(std::memory_order_acquire) == 0;});
+    }
+
+//-----------------TILE RENDERER------------------------------------------------------------------------------
+
+    TileRenderer::TileRenderer()
+        :commands_(), contours_(), masks_(), bins_(), busy_tiles_() {}
+
+    void TileRenderer::RecordFillRect(float left, float top, float right, float bottom,
+                                      dr4::Color color, const ClipRect& clip) {
+        ClipRect bounds = IntersectClip(clip, {(int)floorf(left), (int)floorf(top),
+                                               (int)ceilf(right), (int)ceilf(bottom)});
+        if (bounds.IsEmpty() || color.a == 0) {
+            return;
+        }
+
+        Command command = {};
+        command.type = CommandType::FILL_RECT;
+        command.bounds = bounds;
+        command.clip = clip;
+        command.color = color;
+        command.rect[0] = left;
+        command.rect[1] = top;
+        command.rect[2] = right;
+        command.rect[3] = bottom;
+        commands_.push_back(std::move(command));
+    }
+
+    void TileRenderer::RecordFillPath(const Contour* contours, size_t count, PathPoint offset,
+                                      dr4::Color color, const ClipRect& clip) {
+        if (color.a == 0) {
+            return;
+        }
+
+        float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+        for (size_t i = 0; i < count; i++) {
+            for (PathPoint point : contours[i].points) {
+                min_x = std::min(min_x, point.x);
+                min_y = std::min(min_y, point.y);
+                max_x = std::max(max_x, point.x);
+                max_y = std::max(max_y, point.y);
+            }
+        }
+        if (min_x > max_x) {
+            return;
+        }
+
+        ClipRect bounds = IntersectClip(clip, {(int)floorf(offset.x + min_x), (int)floorf(offset.y + min_y),
+                                               (int)ceilf(offset.x + max_x),  (int)ceilf(offset.y + max_y)});
+        if (bounds.IsEmpty()) {
+            return;
+        }
+
+        Command command = {};
+        command.type = CommandType::FILL_PATH;
+        command.bounds = bounds;
+        command.clip = clip;
+        command.color = color;
+        command.offset = offset;
+        command.first = contours_.size();
+        command.count = count;
+        contours_.insert(contours_.end(), contours, contours + count);
+        commands_.push_back(std::move(command));
+    }
+
+    void TileRenderer::RecordBlitMask(const uint8_t* mask, unsigned width, unsigned height, int x, int y,
+                                      dr4::Color color, const ClipRect& clip) {
+        ClipRect bounds = IntersectClip(clip, {x, y, x + (int)width, y + (int)height});
+        if (bounds.IsEmpty() || color.a == 0) {
+            return;
+        }
+
+        Command command = {};
+        command.type = CommandType::BLIT_MASK;
+        command.bounds = bounds;
+        command.clip = clip;
+        command.color = color;
+        command.offset = {(float)x, (float)y};
+        command.first = masks_.size();
+        command.width = width;
+        command.height = height;
+        masks_.insert(masks_.end(), mask, mask + (size_t)width * height);
+        commands_.push_back(std::move(command));
+    }
+
+    void TileRenderer::RecordBlitSurface(const std::shared_ptr<const Surface>& source, int x, int y,
+                                         const ClipRect& clip) {
+        ClipRect bounds = IntersectClip(clip, {x, y, x + (int)source->width, y + (int)source->height});
+        if (bounds.IsEmpty()) {
+            return;
+        }
+
+        Command command = {};
+        command.type = CommandType::BLIT_SURFACE;
+        command.bounds = bounds;
+        command.clip = clip;
+        command.offset = {(float)x, (float)y};
+        command.source = source;
+        commands_.push_back(std::move(command));
+    }
+
+    void TileRenderer::Discard() {
+        commands_.clear();
+        contours_.clear();
+        masks_.clear();
+    }
+
+    void TileRenderer::RunCommand(Surface& surface, const Command& command, const ClipRect& tile) const {
+        ClipRect clip = IntersectClip(command.clip, tile);
+
+        switch (command.type) {
+            case CommandType::FILL_RECT : {
+                FillRect(surface, command.rect[0], command.rect[1], command.rect[2], command.rect[3],
+                         command.color, clip);
+                break;
+            }
+            case CommandType::FILL_PATH : {
+                FillPath(surface, contours_.data() + command.first, command.count, command.offset,
+                         command.color, clip);
+                break;
+            }
+            case CommandType::BLIT_MASK : {
+                BlitMask(surface, masks_.data() + command.first, command.width, command.height, command.width,
+                         command.offset.x, command.offset.y, command.color, clip);
+                break;
+            }
+            case CommandType::BLIT_SURFACE : {
+                BlitSurface(surface, *command.source, command.offset.x, command.offset.y, clip);
+                break;
+            }
+        }
+    }
+
+    void TileRenderer::Flush(Surface& surface) {
+        if (commands_.empty()) {
+            return;
+        }
+
+        unsigned tiles_x = (surface.width + kTileSize - 1) / kTileSize;
+        unsigned tiles_y = (surface.height + kTileSize - 1) / kTileSize;
+        bins_.resize((size_t)tiles_x * tiles_y);
+
+        for (uint32_t i = 0; i < commands_.size(); i++) {
+            ClipRect bounds = IntersectClip(commands_[i].bounds, SurfaceClip(surface));
+            if (bounds.IsEmpty()) {
+                continue;
+            }
+            for (unsigned ty = bounds.top / kTileSize; ty <= (bounds.bottom - 1) / kTileSize; ty++) {
+                for (unsigned tx = bounds.left / kTileSize; tx <= (bounds.right - 1) / kTileSize; tx++) {
+                    bins_[(size_t)ty * tiles_x + tx].push_back(i);
+                }
+            }
+        }
+
+        busy_tiles_.clear();
+        for (size_t tile = 0; tile < bins_.size(); tile++) {
+            if (!bins_[tile].empty()) {
+                busy_tiles_.push_back(tile);
+            }
+        }
+
+        // Tiles don't overlap, so workers write to the surface without locking
+        WorkStealingPool::Get().ParallelFor(busy_tiles_.size(), [&](size_t task) {
+            size_t tile = busy_tiles_[task];
+            int left = (tile % tiles_x) * kTileSize;
+            int top = (tile / tiles_x) * kTileSize;
+            ClipRect tile_rect = {left, top, left + (int)kTileSize, top + (int)kTileSize};
+
+            for (uint32_t index : bins_[tile]) {
+                RunCommand(surface, commands_[index], tile_rect);
+            }
+            bins_[tile].clear();
+        });
+
+        Discard();
+    }
+
+}
+}